@@ -0,0 +1,185 @@
+#include "ActiveSet.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <limits>
+
+void ActiveSet::initialize(size_t width, size_t height, const std::vector<uint32_t>& particleSlots)
+{
+	tileRows = (height + tileSize - 1) / tileSize;
+	tileColumns = (width + tileSize - 1) / tileSize;
+	tiles.assign(tileRows * tileColumns, Tile());
+	tileOffsets.assign(tiles.size() + 1, 0);
+	tileSpans.clear();
+	particleAwake.assign(width * height, 1);
+	awakeTilesPerRow.assign(tileRows, 0);
+
+	for (size_t tileRow = 0; tileRow < tileRows; ++tileRow)
+	{
+		for (size_t tileColumn = 0; tileColumn < tileColumns; ++tileColumn)
+		{
+			const size_t tile = tileRow * tileColumns + tileColumn;
+			const size_t rowEnd = std::min(height, (tileRow + 1) * tileSize);
+			const size_t columnEnd = std::min(width, (tileColumn + 1) * tileSize);
+			for (size_t row = tileRow * tileSize; row < rowEnd; ++row)
+			{
+				for (size_t column = tileColumn * tileSize; column < columnEnd; ++column)
+				{
+					const uint32_t slot = particleSlots[row * width + column];
+					if (tileSpans.size() > tileOffsets[tile] && tileSpans.back().end == slot)
+						++tileSpans.back().end;
+					else
+						tileSpans.push_back({ slot, slot + 1 });
+				}
+			}
+
+			const size_t centerRow = (tileRow * tileSize + rowEnd) / 2;
+			const size_t centerColumn = (tileColumn * tileSize + columnEnd) / 2;
+			tiles[tile].center = particleSlots[centerRow * width + centerColumn];
+			tileOffsets[tile + 1] = (uint32_t)tileSpans.size();
+		}
+	}
+
+	hasLastColliders = false;
+	rebuildAwakeTiles();
+}
+
+void ActiveSet::wakeAll()
+{
+	for (size_t tile = 0; tile < tiles.size(); ++tile)
+	{
+		setAsleep(tile, false);
+		tiles[tile].quietSteps = 0;
+	}
+	rebuildAwakeTiles();
+}
+
+void ActiveSet::recordMotion(size_t tile, float maxSpeed, float maxAcceleration)
+{
+	Tile& state = tiles[tile];
+	state.moving = maxSpeed > sleepSpeed || maxAcceleration > sleepAcceleration;
+	state.quietSteps = state.moving ? 0 : state.quietSteps + 1;
+}
+
+bool ActiveSet::hasQuietTiles() const
+{
+	for (uint32_t tile : awakeTiles)
+	{
+		if (tiles[tile].quietSteps > 0)
+			return true;
+	}
+	return false;
+}
+
+void ActiveSet::sleepQuietTiles(Particles& particles, float contactOffset, const std::function<glm::vec3(uint32_t)>& externalForce)
+{
+	bool changed = false;
+	for (uint32_t tile : awakeTiles)
+	{
+		Tile& state = tiles[tile];
+		if (state.quietSteps < sleepDelay) continue;
+
+		// Velocities are implied by the previous positions, so they are zeroed by moving those onto the positions
+		state.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		state.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+		for (const Span* span = getTileSpansBegin(tile); span != getTileSpansEnd(tile); ++span)
+		{
+			for (uint32_t i = span->begin; i < span->end; ++i)
+			{
+				const glm::vec3 position = particles.getPosition(i);
+				particles.previousX[i] = position.x;
+				particles.previousY[i] = position.y;
+				particles.previousZ[i] = position.z;
+				state.boundsMin = glm::min(state.boundsMin, position);
+				state.boundsMax = glm::max(state.boundsMax, position);
+			}
+		}
+		state.boundsMin -= glm::vec3(contactOffset);
+		state.boundsMax += glm::vec3(contactOffset);
+		state.referenceForce = externalForce(state.center);
+		setAsleep(tile, true);
+		changed = true;
+	}
+
+	if (changed)
+		rebuildAwakeTiles();
+}
+
+void ActiveSet::wakeDisturbedTiles(const CollisionWorld& colliders, float maxForceChange, const std::function<glm::vec3(uint32_t)>& externalForce)
+{
+	// Colliders that appeared, moved or went away since the last step
+	movedColliders.clear();
+	for (uint32_t c = 0; c < std::max(colliders.size(), lastColliders.size()) && hasLastColliders; ++c)
+	{
+		if (c >= colliders.size() || colliders.hasChanged(c, lastColliders))
+			movedColliders.push_back(c);
+	}
+
+	// Decided for all tiles first, so that waking does not cascade within one step
+	std::vector<uint32_t> woken;
+	for (size_t tileRow = 0; tileRow < tileRows; ++tileRow)
+	{
+		for (size_t tileColumn = 0; tileColumn < tileColumns; ++tileColumn)
+		{
+			const size_t tile = tileRow * tileColumns + tileColumn;
+			const Tile& state = tiles[tile];
+			if (!state.asleep) continue;
+
+			bool disturbed = false;
+			for (size_t r = (tileRow > 0 ? tileRow - 1 : 0); r <= std::min(tileRow + 1, tileRows - 1) && !disturbed; ++r)
+			{
+				for (size_t c = (tileColumn > 0 ? tileColumn - 1 : 0); c <= std::min(tileColumn + 1, tileColumns - 1); ++c)
+				{
+					const Tile& neighbour = tiles[r * tileColumns + c];
+					if (!neighbour.asleep && neighbour.moving)
+					{
+						disturbed = true;
+						break;
+					}
+				}
+			}
+
+			for (size_t m = 0; m < movedColliders.size() && !disturbed; ++m)
+			{
+				const uint32_t c = movedColliders[m];
+				disturbed = (c < colliders.size() && colliders.overlaps(c, state.boundsMin, state.boundsMax, 0.f)) ||
+					(c < lastColliders.size() && lastColliders.overlaps(c, state.boundsMin, state.boundsMax, 0.f));
+			}
+
+			if (!disturbed)
+				disturbed = glm::length(externalForce(state.center) - state.referenceForce) > maxForceChange;
+
+			if (disturbed)
+				woken.push_back((uint32_t)tile);
+		}
+	}
+
+	lastColliders = colliders;
+	hasLastColliders = true;
+	for (uint32_t tile : woken)
+	{
+		setAsleep(tile, false);
+		tiles[tile].quietSteps = 0;
+		tiles[tile].moving = false;
+	}
+	if (!woken.empty())
+		rebuildAwakeTiles();
+}
+
+void ActiveSet::setAsleep(size_t tile, bool asleep)
+{
+	tiles[tile].asleep = asleep;
+	for (const Span* span = getTileSpansBegin(tile); span != getTileSpansEnd(tile); ++span)
+		std::fill(particleAwake.begin() + span->begin, particleAwake.begin() + span->end, asleep ? 0 : 1);
+}
+
+void ActiveSet::rebuildAwakeTiles()
+{
+	awakeTiles.clear();
+	std::fill(awakeTilesPerRow.begin(), awakeTilesPerRow.end(), 0);
+	for (size_t tile = 0; tile < tiles.size(); ++tile)
+	{
+		if (tiles[tile].asleep) continue;
+		awakeTiles.push_back((uint32_t)tile);
+		++awakeTilesPerRow[tile / tileColumns];
+	}
+}
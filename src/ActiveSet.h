@@ -0,0 +1,80 @@
+#pragma once
+#include "Particles.h"
+#include "CollisionWorld.h"
+#include <glm/vec3.hpp>
+#include <vector>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+// Square tiles of a particle grid that fall asleep once they have rested for a while, so that only the awake
+// ones are simulated. A sleeping tile keeps its positions with zero velocity and acts as a temporary pin for
+// its awake neighbours. It wakes when a neighbour moves, the collider moves into it or its external force
+// (gravity and wind) changes.
+class ActiveSet {
+public:
+	static constexpr size_t tileSize = 8;
+
+	// Consecutive memory slots begin .. end of a tile's particles
+	struct Span {
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	// Tiles are laid over the original row-major grid, particleSlots maps grid indices to memory slots
+	void initialize(size_t width, size_t height, const std::vector<uint32_t>& particleSlots);
+	void wakeAll();
+
+	// Largest particle speed and acceleration of an awake tile over the last step
+	void recordMotion(size_t tile, float maxSpeed, float maxAcceleration);
+
+	// Tiles that stayed below the motion thresholds for sleepDelay steps fall asleep with zero velocity.
+	// externalForce(slot) gives the external force on a resting particle, kept as the reference for waking.
+	void sleepQuietTiles(Particles& particles, float contactOffset, const std::function<glm::vec3(uint32_t)>& externalForce);
+
+	// Sleeping tiles next to a moving tile, touched by a collider that moved before or after its move, or whose
+	// external force changed by more than maxForceChange wake up
+	void wakeDisturbedTiles(const CollisionWorld& colliders, float maxForceChange, const std::function<glm::vec3(uint32_t)>& externalForce);
+
+	// Whether an awake tile stayed below the motion thresholds in the last step it was recorded in
+	bool hasQuietTiles() const;
+
+	size_t getTileCount() const { return tiles.size(); }
+	size_t getTileRowCount() const { return tileRows; }
+	size_t getTileColumnCount() const { return tileColumns; }
+	const std::vector<uint32_t>& getAwakeTiles() const { return awakeTiles; }
+	bool isTileRowAwake(size_t tileRow) const { return awakeTilesPerRow[tileRow] > 0; }
+	const uint8_t* getParticleAwake() const { return particleAwake.data(); }
+	const Span* getTileSpansBegin(size_t tile) const { return tileSpans.data() + tileOffsets[tile]; }
+	const Span* getTileSpansEnd(size_t tile) const { return tileSpans.data() + tileOffsets[tile + 1]; }
+
+	static constexpr float sleepSpeed = 0.02f;
+	static constexpr float sleepAcceleration = 1.f;
+	static constexpr unsigned sleepDelay = 120;
+
+private:
+	struct Tile {
+		bool asleep = false;
+		bool moving = true;
+		unsigned quietSteps = 0;
+		uint32_t center = 0;
+		glm::vec3 boundsMin{ 0.f };
+		glm::vec3 boundsMax{ 0.f };
+		glm::vec3 referenceForce{ 0.f };
+	};
+
+	void setAsleep(size_t tile, bool asleep);
+	void rebuildAwakeTiles();
+
+	size_t tileRows = 0;
+	size_t tileColumns = 0;
+	std::vector<Tile> tiles;
+	std::vector<uint32_t> tileOffsets;
+	std::vector<Span> tileSpans;
+	std::vector<uint32_t> awakeTiles;
+	std::vector<uint32_t> awakeTilesPerRow;
+	std::vector<uint8_t> particleAwake;
+	CollisionWorld lastColliders;
+	std::vector<uint32_t> movedColliders;
+	bool hasLastColliders = false;
+};
@@ -1,98 +1,1184 @@
 #include "Cloth.h"
-#include <glad/glad.h>
-#include <iostream>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
 
-Cloth::Cloth(size_t horizontalCount, size_t verticalCount)
+Cloth::Cloth(size_t _horizontalCount, size_t _verticalCount) : horizontalCount(_horizontalCount), verticalCount(_verticalCount)
 {
 	if (horizontalCount % 2 != 0) ++horizontalCount;
 	if (verticalCount % 2 != 0) ++verticalCount;
-	indicesCount = (horizontalCount - 1) * (verticalCount - 1) * 6;
-	verticesCount = horizontalCount * verticalCount;
-	constructModel(horizontalCount, verticalCount);
+	constructModel();
 }
 
-Cloth::~Cloth()
+void Cloth::setSimdLevel(SimdLevel level)
 {
-	glDeleteBuffers(1, &ebo);
+	simdLevel = std::min(level, getSupportedSimdLevel());
+	springForceKernel = getSpringForceKernel(simdLevel);
 }
 
-void Cloth::draw() const
+void Cloth::updatePhysics(const Time& t, const CollisionWorld& colliders)
 {
-	glBindVertexArray(vao);
-	glDrawElements(GL_TRIANGLES, indicesCount, GL_UNSIGNED_INT, nullptr);
-	glBindVertexArray(0);
+	if (t.deltaTime <= 0.f) return;
+	if (restPoseVersion != getTransformVersion())
+		updateRestPositions();
+
+	// A cloth that is asleep as a whole only checks whether anything disturbs it
+	if (usesActiveSet() && activeSet.getAwakeTiles().empty())
+	{
+		updateActiveSet(t, colliders);
+		if (activeSet.getAwakeTiles().empty())
+		{
+			lastSubstepCount = 0;
+			return;
+		}
+	}
+
+	// The reduced model is unconditionally stable and keeps no particle state to roll back
+	if (!adaptiveTimeStep || usesSubspace())
+	{
+		advance(t, colliders, substepCount);
+		lastSubstepCount = substepCount;
+		return;
+	}
+
+	// Frames longer than the substep budget covers at the stable step are simulated slower instead of blowing up
+	const float stableTimeStep = estimateStableTimeStep();
+	Time frame = t;
+	frame.deltaTime = std::min(t.deltaTime, maxAdaptiveSubsteps * stableTimeStep);
+	unsigned count = std::max(substepCount, (unsigned)std::ceil(frame.deltaTime / stableTimeStep));
+	count = std::min(count, maxAdaptiveSubsteps);
+
+	// A frame that diverges is rolled back and retried with half the substep length. If even the substep budget
+	// does not help, the frame is dropped and the cloth stays in its last good state.
+	saveState();
+	while (true)
+	{
+		solverFailed = false;
+		advance(frame, colliders, count);
+		// Velocities are implied over the integration step, which is a fine step in multirate
+		if (!checkDivergence(lastSubstepTime))
+		{
+			stepSafety = std::min(maxStepSafety, stepSafety * 1.05f);
+			break;
+		}
+
+		++rollbackCount;
+		restoreState();
+		stepSafety = std::max(minStepSafety, stepSafety * 0.5f);
+		if (count * 2 > maxAdaptiveSubsteps)
+			break;
+		count *= 2;
+	}
+
+	lastSubstepCount = count;
+}
+
+void Cloth::advance(const Time& t, const CollisionWorld& colliders, unsigned count)
+{
+	Time substep = t;
+	substep.deltaTime = t.deltaTime / count;
+	substep.frameRate = t.frameRate * count;
+
+	// Velocities are implied by the previous positions, so they are rescaled whenever the integration step changes
+	const bool multirate = solver == Solver::Explicit && multirateSteps > 1;
+	const float integrationStep = multirate ? substep.deltaTime / multirateSteps : substep.deltaTime;
+	if (lastSubstepTime > 0.f && integrationStep != lastSubstepTime)
+	{
+		const float ratio = integrationStep / lastSubstepTime;
+		parallelFor(particles.size(), [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+			{
+				particles.previousX[i] = particles.x[i] - (particles.x[i] - particles.previousX[i]) * ratio;
+				particles.previousY[i] = particles.y[i] - (particles.y[i] - particles.previousY[i]) * ratio;
+				particles.previousZ[i] = particles.z[i] - (particles.z[i] - particles.previousZ[i]) * ratio;
+			}
+		});
+	}
+	substep.lastDeltaTime = substep.deltaTime;
+	lastSubstepTime = integrationStep;
+
+	// Tiles left asleep by a mode that does not use the active set would not notice how the cloth moved since
+	if (!usesActiveSet() && activeSet.getAwakeTiles().size() != activeSet.getTileCount())
+		activeSet.wakeAll();
+
+	const bool temporalBlocking = usesTemporalBlocking();
+	for (unsigned i = 0; i < count; ++i)
+	{
+		if (temporalBlocking)
+		{
+			const unsigned stepCount = std::min(substepsPerTile, count - i);
+			stepTemporalBlocks(substep, colliders, stepCount);
+			sweepStarts.clear();
+			i += stepCount - 1;
+			continue;
+		}
+
+		switch (solver)
+		{
+			case Solver::Explicit:
+				if (multirateSteps > 1)
+				{
+					stepMultirate(substep, colliders);
+					break;
+				}
+			{
+				const bool trackSleep = usesActiveSet() && isSleepTracked();
+				integrate(substep, colliders, trackSleep);
+				if (trackSleep)
+					updateActiveSet(substep, colliders);
+				accumulateForces(substep);
+				break;
+			}
+			case Solver::Implicit:
+				stepImplicit(substep, colliders);
+				break;
+			case Solver::XPBD:
+				stepXPBD(substep, colliders);
+				break;
+			case Solver::ProjectiveDynamics:
+				stepProjectiveDynamics(substep, colliders);
+				break;
+			case Solver::VBD:
+				stepVBD(substep, colliders);
+				break;
+			case Solver::Multigrid:
+				stepMultigrid(substep, colliders);
+				break;
+			case Solver::Subspace:
+				stepSubspace(substep);
+				break;
+		}
+		if (selfCollision && solver != Solver::Subspace)
+			selfCollider.solve(particles, selfCollisionDistance, usesActiveSet() ? activeSet.getParticleAwake() : nullptr, threadPool.get());
+		// Colliders only move between calls, so only the first integration sweeps them
+		sweepStarts.clear();
+
+		substep.lastDeltaTime = substep.deltaTime;
+		substep.runningTime += substep.deltaTime;
+	}
+	if (continuousCollision)
+		colliders.getSweepStarts(sweepStarts);
+}
+
+float Cloth::estimateStableTimeStep() const
+{
+	// The other solvers are unconditionally stable; they only rely on the divergence check
+	if (solver != Solver::Explicit)
+		return std::numeric_limits<float>::infinity();
+
+	// Gershgorin bound on the largest eigenvalue of M^-1 K, plus the linearized air resistance of the fastest
+	// particle, against the stability limit h * omega < 2 of the Verlet integrator
+	const float dragRate = 2.f * airResistance * lastMaxSpeed / particleMass;
+	if (multirateSteps <= 1)
+		return stepSafety * 2.f / (std::sqrt(2.f * maxStiffnessPerMass) + dragRate);
+
+	// Multirate: the fine steps have to resolve the stiff springs and the drag, the coarse step the bending springs
+	const float fineLimit = 2.f / (std::sqrt(2.f * maxFastStiffnessPerMass) + dragRate);
+	const float coarseLimit = 2.f / std::sqrt(2.f * maxSlowStiffnessPerMass);
+	return stepSafety * std::min(fineLimit * multirateSteps, coarseLimit);
+}
+
+bool Cloth::checkDivergence(float timeStep)
+{
+	// Kinetic energy and speed from the implied velocities. NaNs propagate into both and fail the comparisons below.
+	const double kineticEnergy = parallelSum(threadPool.get(), particles.size(), [&](size_t begin, size_t end) {
+		double sum = 0.0;
+		for (size_t i = begin; i < end; ++i)
+		{
+			const glm::vec3 displacement = particles.getPosition(i) - particles.getPreviousPosition(i);
+			sum += glm::dot(displacement, displacement);
+		}
+		return sum;
+	}) * 0.5 * particleMass / ((double)timeStep * timeStep);
+	const double maxSpeedSquared = parallelMax(threadPool.get(), particles.size(), [&](size_t begin, size_t end) {
+		double maximum = 0.0;
+		for (size_t i = begin; i < end; ++i)
+		{
+			const glm::vec3 displacement = particles.getPosition(i) - particles.getPreviousPosition(i);
+			maximum = std::max(maximum, (double)glm::dot(displacement, displacement));
+		}
+		return maximum;
+	});
+
+	// Springs stretched past the strain limit within the frame, relative to their rest length or to their length at
+	// the start of the frame, whichever is longer. Springs next to the pins stay stretched well past their rest
+	// length under the weight of the hanging cloth, so only the growth within a frame points to divergence.
+	const double overstretched = parallelSum(threadPool.get(), springs.size(), [&](size_t begin, size_t end) {
+		double count = 0.0;
+		for (size_t s = begin; s < end; ++s)
+		{
+			const float length = glm::length(particles.getPosition(springs.particle2[s]) - particles.getPosition(springs.particle1[s]));
+			const float startLength = glm::length(rollbackState.getPosition(springs.particle2[s]) - rollbackState.getPosition(springs.particle1[s]));
+			if (!(length <= (1.f + maxStrain) * std::max(springs.restLength[s], startLength)))
+				count += 1.0;
+		}
+		return count;
+	});
+
+	// Energy may grow quickly from rest, so the spike test only applies above that of every particle moving at 1 unit/s
+	const double energyFloor = 0.5 * particleMass * particles.size();
+	const bool energySpike = !(kineticEnergy <= energySpikeFactor * std::max(lastKineticEnergy, energyFloor));
+	if (solverFailed || energySpike || overstretched > 0.0 || !(maxSpeedSquared < std::numeric_limits<double>::infinity()))
+		return true;
+
+	lastKineticEnergy = kineticEnergy;
+	lastMaxSpeed = (float)std::sqrt(maxSpeedSquared) / timeStep;
+	return false;
+}
+
+void Cloth::saveState()
+{
+	rollbackState.resize(particles.size());
+	for (std::vector<float> Particles::* component : { &Particles::x, &Particles::y, &Particles::z,
+		&Particles::previousX, &Particles::previousY, &Particles::previousZ, &Particles::forceX, &Particles::forceY, &Particles::forceZ })
+		std::copy((particles.*component).begin(), (particles.*component).end(), (rollbackState.*component).begin());
+	rollbackSubstepTime = lastSubstepTime;
+	rollbackSweepStarts = sweepStarts;
+}
+
+void Cloth::restoreState()
+{
+	for (std::vector<float> Particles::* component : { &Particles::x, &Particles::y, &Particles::z,
+		&Particles::previousX, &Particles::previousY, &Particles::previousZ, &Particles::forceX, &Particles::forceY, &Particles::forceZ })
+		std::copy((rollbackState.*component).begin(), (rollbackState.*component).end(), (particles.*component).begin());
+	lastSubstepTime = rollbackSubstepTime;
+	sweepStarts = rollbackSweepStarts;
+	slowForcesValid = false;
+	activeSet.wakeAll();
+}
+
+void Cloth::setSolver(Solver _solver)
+{
+	if (usesSubspace() && _solver != Solver::Subspace)
+		writeSubspaceState();
+	solver = _solver;
+	initializeSolvers();
+	activeSet.wakeAll();
+}
+
+void Cloth::setSelfCollision(bool enabled)
+{
+	selfCollision = enabled;
+	initializeSolvers();
+}
+
+void Cloth::setContinuousCollision(bool enabled)
+{
+	continuousCollision = enabled;
+	sweepStarts.clear();
+}
+
+void Cloth::setSleeping(bool enabled)
+{
+	sleeping = enabled;
+	activeSet.wakeAll();
+}
+
+bool Cloth::usesActiveSet() const
+{
+	return sleeping && solver == Solver::Explicit && multirateSteps <= 1 && !usesTemporalBlocking();
+}
+
+bool Cloth::usesTemporalBlocking() const
+{
+	// Tethers reach from a tile to pins far outside its halo, and self-collision to any fold of the cloth, so neither
+	// can be applied within a group of substeps
+	return solver == Solver::Explicit && multirateSteps <= 1 && substepsPerTile > 1 && forceKernel == ForceKernel::Stencil &&
+		particleOrdering == ParticleOrdering::RowMajor && !tethers && !selfCollision;
+}
+
+void Cloth::updateActiveSet(const Time& t, const CollisionWorld& colliders)
+{
+	// Sleeping particles have no velocity, so their external force is gravity and wind alone
+	auto restingForce = [&](uint32_t slot) { return computeExternalForce(t, particles, slot); };
+	activeSet.sleepQuietTiles(particles, contactOffset, restingForce);
+	activeSet.wakeDisturbedTiles(colliders, particleMass * wakeAcceleration, restingForce);
+}
+
+void Cloth::setParticleOrdering(ParticleOrdering ordering)
+{
+	// New order of the original indices
+	std::vector<uint32_t> order(particles.size());
+	if (ordering == ParticleOrdering::Morton)
+		order = computeMortonOrdering(initialPositions);
+	else if (ordering == ParticleOrdering::ReverseCuthillMcKee)
+	{
+		Graph graph;
+		graph.offsets.assign(particles.size() + 1, 0);
+		graph.neighbours.resize(springAdjacency.size());
+		for (size_t slot = 0; slot < particles.size(); ++slot)
+			graph.offsets[particleOrder[slot] + 1] = springAdjacencyOffsets[slot + 1] - springAdjacencyOffsets[slot];
+		for (size_t i = 0; i < particles.size(); ++i)
+			graph.offsets[i + 1] += graph.offsets[i];
+
+		for (size_t slot = 0; slot < particles.size(); ++slot)
+		{
+			uint32_t fill = graph.offsets[particleOrder[slot]];
+			for (uint32_t a = springAdjacencyOffsets[slot]; a < springAdjacencyOffsets[slot + 1]; ++a)
+			{
+				const uint32_t s = springAdjacency[a] >> 1;
+				graph.neighbours[fill++] = particleOrder[(springAdjacency[a] & 1) ? springs.particle1[s] : springs.particle2[s]];
+			}
+		}
+		order = computeReverseCuthillMcKeeOrdering(graph);
+	}
+	else
+	{
+		for (size_t i = 0; i < order.size(); ++i)
+			order[i] = (uint32_t)i;
+	}
+
+	// Move every particle from its current slot to its new one and rename the spring endpoints to match
+	std::vector<uint32_t> source(order.size());
+	std::vector<uint32_t> newSlots(order.size());
+	for (size_t k = 0; k < order.size(); ++k)
+	{
+		source[k] = particleSlots[order[k]];
+		newSlots[source[k]] = (uint32_t)k;
+	}
+
+	particles.permute(source);
+	springs.remapParticles(newSlots);
+	particleOrder = order;
+	for (size_t k = 0; k < order.size(); ++k)
+		particleSlots[order[k]] = (uint32_t)k;
+	particleOrdering = ordering;
+	slowForcesValid = false;
+	activeSet.initialize(horizontalCount, verticalCount, particleSlots);
+
+	buildSpringAdjacency();
+	updateRestPositions();
+	initializeSolvers(true);
 }
 
-void Cloth::updatePhysics(const Time& t, const Sphere& sphere)
+void Cloth::initializeSolvers(bool topologyChanged)
 {
-	if (glm::abs(t.deltaTime - t.lastDeltaTime) > 0.01f) return;
+	// The active solver builds its topology on first use; after a reordering every solver that has one rebuilds it
+	auto needsInitialization = [&](Solver candidate, bool initialized) {
+		return (solver == candidate && !initialized) || (topologyChanged && initialized);
+	};
+
+	if (needsInitialization(Solver::Implicit, implicitSolver.isInitialized()))
+		implicitSolver.initialize(particles, springs, springAdjacencyOffsets, springAdjacency);
+	if (needsInitialization(Solver::XPBD, xpbdSolver.isInitialized()))
+		xpbdSolver.initialize(springs, springAdjacencyOffsets, springAdjacency);
+	if (needsInitialization(Solver::ProjectiveDynamics, projectiveDynamicsSolver.isInitialized()))
+		projectiveDynamicsSolver.initialize(particles, springs, springAdjacencyOffsets, springAdjacency);
+	if ((selfCollision && !selfCollider.isInitialized()) || (topologyChanged && selfCollider.isInitialized()))
+		selfCollider.initialize(springs, springAdjacencyOffsets, springAdjacency);
+
+	// Bending springs reach two rows and columns, so the grid needs 3 x 3 colors. The coloring is made
+	// on original grid indices and then moved to memory slots, in memory order within every color.
+	auto colorParticles = [&]() {
+		Coloring coloring = colorGrid(horizontalCount, verticalCount, 2);
+		for (uint32_t& particle : coloring.order)
+			particle = particleSlots[particle];
+		for (size_t c = 0; c < coloring.getColorCount(); ++c)
+			std::sort(coloring.order.begin() + coloring.colorOffsets[c], coloring.order.begin() + coloring.colorOffsets[c + 1]);
+		return coloring;
+	};
+
+	if (needsInitialization(Solver::VBD, vbdSolver.isInitialized()))
+		vbdSolver.initialize(particles, colorParticles(), springAdjacencyOffsets, springAdjacency);
+	if (needsInitialization(Solver::Multigrid, multigridSolver.isInitialized()))
+	{
+		multigridSolver.initialize(particles, horizontalCount, verticalCount, particleSlots, springConstants, colorParticles(),
+			springAdjacencyOffsets, springAdjacency);
+	}
+}
+
+void Cloth::getTranslations(std::vector<glm::vec3>& translations) const
+{
+	if (usesSubspace())
+	{
+		subspaceModel->reconstruct(subspaceState, translations);
+		return;
+	}
+
+	translations.resize(particles.size());
 	for (size_t i = 0; i < particles.size(); ++i)
 	{
-		///////////////////////////// Applying translations //////////////////////////////////////////////////////////////////////
-		Cloth::Particle& p = particles[i];
-		const glm::vec3 velocity = translations[i] - p.previousTranslation;
-		if (!p.fixed)
+		const uint32_t slot = particleSlots[i];
+		translations[i] = particles.getPosition(slot) - particles.getRestPosition(slot);
+	}
+}
+
+void Cloth::updateRestPositions()
+{
+	// Particles keep their offset from the rest pose, so a transform change carries them along
+	const glm::mat4& transform = getTransformMatrix();
+	activeSet.wakeAll();
+	parallelFor(particles.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			const glm::vec3 rest = glm::vec3(transform * glm::vec4(initialPositions[particleOrder[i]], 1.f));
+			const glm::vec3 shift = rest - particles.getRestPosition(i);
+			particles.x[i] += shift.x;
+			particles.y[i] += shift.y;
+			particles.z[i] += shift.z;
+			particles.previousX[i] += shift.x;
+			particles.previousY[i] += shift.y;
+			particles.previousZ[i] += shift.z;
+			particles.restX[i] = rest.x;
+			particles.restY[i] = rest.y;
+			particles.restZ[i] = rest.z;
+		}
+	});
+
+	parallelFor(springs.size(), [&](size_t begin, size_t end) {
+		for (size_t s = begin; s < end; ++s)
+			springs.restLength[s] = glm::length(particles.getRestPosition(springs.particle2[s]) - particles.getRestPosition(springs.particle1[s]));
+	});
+
+	// The grid is transformed affinely, so every stencil direction has a single rest length
+	for (size_t o = 0; o < ClothStencil::count; ++o)
+	{
+		const StencilOffset& offset = ClothStencil::offsets[o];
+		const size_t row = offset.row < 0 ? -offset.row : 0;
+		const size_t column = offset.column < 0 ? -offset.column : 0;
+		const size_t first = row * horizontalCount + column;
+		const size_t second = (row + offset.row) * horizontalCount + column + offset.column;
+		stencilRestLength[o] = glm::length(particles.getRestPosition(particleSlots[second]) - particles.getRestPosition(particleSlots[first]));
+	}
+
+	contactOffset = glm::length(particles.getRestPosition(0) - particles.getRestPosition(1)) / 6.f;
+	selfCollisionDistance = 3.f * contactOffset;
+	buildTethers();
+	restPoseVersion = getTransformVersion();
+}
+
+void Cloth::buildTethers()
+{
+	// Shortest paths along the springs from all pins at once. Paths over the diagonals overestimate the geodesic
+	// distance by a few percent at most, which only adds to the slack.
+	tetherAnchors.assign(particles.size(), noTether);
+	tetherLengths.assign(particles.size(), std::numeric_limits<float>::infinity());
+	using Entry = std::pair<float, uint32_t>;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+	for (size_t slot = 0; slot < particles.size(); ++slot)
+	{
+		if (particles.inverseMass[slot] != 0.f) continue;
+		tetherAnchors[slot] = (uint32_t)slot;
+		tetherLengths[slot] = 0.f;
+		queue.push({ 0.f, (uint32_t)slot });
+	}
+
+	while (!queue.empty())
+	{
+		const Entry entry = queue.top();
+		queue.pop();
+		if (entry.first > tetherLengths[entry.second]) continue;
+		for (uint32_t a = springAdjacencyOffsets[entry.second]; a < springAdjacencyOffsets[entry.second + 1]; ++a)
+		{
+			const uint32_t s = springAdjacency[a] >> 1;
+			const uint32_t other = (springAdjacency[a] & 1) ? springs.particle1[s] : springs.particle2[s];
+			const float length = entry.first + springs.restLength[s];
+			if (length < tetherLengths[other])
+			{
+				tetherLengths[other] = length;
+				tetherAnchors[other] = tetherAnchors[entry.second];
+				queue.push({ length, other });
+			}
+		}
+	}
+
+	for (size_t slot = 0; slot < particles.size(); ++slot)
+	{
+		if (particles.inverseMass[slot] == 0.f)
+			tetherAnchors[slot] = noTether;
+	}
+}
+
+void Cloth::enforceTethers(const CollisionWorld& colliders)
+{
+	if (!tethers) return;
+
+	// The explicit solver projects its particles as it integrates them, see integrateParticles
+	parallelFor(particles.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			glm::vec3 position = particles.getPosition(i);
+			if (!projectOntoTether(colliders, i, position)) continue;
+			particles.x[i] = position.x;
+			particles.y[i] = position.y;
+			particles.z[i] = position.z;
+		}
+	});
+}
+
+bool Cloth::projectOntoTether(const CollisionWorld& colliders, size_t i, glm::vec3& position) const
+{
+	// Particles beyond their tether move straight back towards the pin, which also takes the outward part off their
+	// implied velocity
+	const uint32_t anchor = tetherAnchors[i];
+	if (anchor == noTether)
+		return false;
+
+	const glm::vec3 pin = particles.getPosition(anchor);
+	const glm::vec3 offset = position - pin;
+	const float maxLength = (1.f + tetherStretch) * tetherLengths[i];
+	const float lengthSquared = glm::dot(offset, offset);
+	if (lengthSquared <= maxLength * maxLength)
+		return false;
+
+	position = pin + offset * (maxLength / std::sqrt(lengthSquared));
+	colliders.resolve(contactOffset, position);
+	return true;
+}
+
+bool Cloth::isSleepTracked()
+{
+	// While every tile is awake and none is quiet, the cloth is only probed every few steps for tiles that have come
+	// to rest; a tile that is found quiet keeps the tracking on until it sleeps or moves again
+	if (activeSet.getAwakeTiles().size() < activeSet.getTileCount() || activeSet.hasQuietTiles())
+	{
+		stepsSinceSleepProbe = 0;
+		return true;
+	}
+	if (++stepsSinceSleepProbe < sleepProbeInterval)
+		return false;
+	stepsSinceSleepProbe = 0;
+	return true;
+}
+
+void Cloth::integrate(const Time& t, const CollisionWorld& colliders, bool trackSleep)
+{
+	if (!trackSleep)
+	{
+		parallelFor(particles.size(), [&](size_t begin, size_t end) { integrateParticles(t, colliders, particles, begin, end); });
+		return;
+	}
+
+	// Awake tiles only, recording how fast each one still moves and accelerates for the sleep test
+	const std::vector<uint32_t>& awakeTiles = activeSet.getAwakeTiles();
+	auto integrateTiles = [&](size_t begin, size_t end) {
+		for (size_t k = begin; k < end; ++k)
+		{
+			Motion motion;
+			for (const ActiveSet::Span* span = activeSet.getTileSpansBegin(awakeTiles[k]); span != activeSet.getTileSpansEnd(awakeTiles[k]); ++span)
+				integrateParticles(t, colliders, particles, span->begin, span->end, &motion);
+			activeSet.recordMotion(awakeTiles[k], std::sqrt(motion.maxDisplacementSquared) / t.deltaTime,
+				std::sqrt(motion.maxDisplacementChangeSquared) / (t.deltaTime * t.deltaTime));
+		}
+	};
+
+	const size_t minTiles = std::max<size_t>(1, 1024 / (ActiveSet::tileSize * ActiveSet::tileSize));
+	if (threadPool)
+		threadPool->parallelFor(0, awakeTiles.size(), minTiles, integrateTiles);
+	else
+		integrateTiles(0, awakeTiles.size());
+}
+
+void Cloth::integrateParticles(const Time& t, const CollisionWorld& colliders, Particles& target, size_t begin, size_t end, Motion* motion, bool swept) const
+{
+	swept = swept && !sweepStarts.empty();
+	// Blocks of particles are integrated into a local buffer first, so the narrow phase only runs against the
+	// colliders near the bounds of their new positions. Only the first of several substeps taken at once is swept.
+	const float accelerationFactor = ((t.deltaTime + t.lastDeltaTime) / 2.f) * t.deltaTime;
+	glm::vec3 newPositions[collisionBlockSize];
+	std::vector<uint32_t> candidates;
+	for (size_t blockBegin = begin; blockBegin < end; blockBegin += collisionBlockSize)
+	{
+		const size_t blockEnd = std::min(blockBegin + collisionBlockSize, end);
+		glm::vec3 boundsMin(std::numeric_limits<float>::max()), boundsMax(-std::numeric_limits<float>::max());
+		for (size_t i = blockBegin; i < blockEnd; ++i)
 		{
-			p.tempTranslation = translations[i] + velocity + ((p.forces / particleMass) * ((t.deltaTime + t.lastDeltaTime) / 2.f) * t.deltaTime);
+			const glm::vec3 position = target.getPosition(i);
+			const glm::vec3 velocity = position - target.getPreviousPosition(i);
+			const glm::vec3 force(target.forceX[i], target.forceY[i], target.forceZ[i]);
+			newPositions[i - blockBegin] = position + velocity + force * target.inverseMass[i] * accelerationFactor;
+			boundsMin = glm::min(boundsMin, newPositions[i - blockBegin]);
+			boundsMax = glm::max(boundsMax, newPositions[i - blockBegin]);
+		}
+		if (!swept)
+			colliders.query(boundsMin, boundsMax, contactOffset, candidates);
+		else
+			colliders.querySwept(sweepStarts, boundsMin, boundsMax, contactOffset, candidates);
+
+		for (size_t i = blockBegin; i < blockEnd; ++i)
+		{
+			if (target.inverseMass[i] == 0.f) continue;
 
-			// Cloth-sphere collision
-			const float offset = glm::distance(sphere.getTranslation(), p.transformedPosition + p.tempTranslation) - sphere.getRadius();
-			const float additionalOffset = glm::length(particles[0].transformedPosition - particles[1].transformedPosition) / 6.f;
-			static bool written = false;
-			if (!written) 
+			const glm::vec3 position = target.getPosition(i);
+			glm::vec3 newPosition = newPositions[i - blockBegin];
+			if (!swept)
+				colliders.resolve(candidates.data(), candidates.size(), contactOffset, newPosition);
+			else
+				colliders.resolveSwept(sweepStarts, candidates.data(), candidates.size(), contactOffset, position, newPosition);
+
+			// Tethers are projected right here rather than after the pass, so that the motion the sleep test sees is
+			// the one the particle ends up with. Tiles of temporal blocking have their own slots and never get here
+			// with tethers on.
+			if (tethers && &target == &particles)
+				projectOntoTether(colliders, i, newPosition);
+			if (motion)
 			{
-				std::cout << additionalOffset << std::endl;
-				written = true;
+				const glm::vec3 velocity = position - target.getPreviousPosition(i);
+				const glm::vec3 displacement = newPosition - position;
+				motion->maxDisplacementSquared = std::max(motion->maxDisplacementSquared, glm::dot(displacement, displacement));
+				motion->maxDisplacementChangeSquared = std::max(motion->maxDisplacementChangeSquared, glm::dot(displacement - velocity, displacement - velocity));
 			}
-			if (offset < additionalOffset)
+			target.previousX[i] = position.x;
+			target.previousY[i] = position.y;
+			target.previousZ[i] = position.z;
+			target.x[i] = newPosition.x;
+			target.y[i] = newPosition.y;
+			target.z[i] = newPosition.z;
+		}
+	}
+}
+
+void Cloth::stepImplicit(const Time& t, const CollisionWorld& colliders)
+{
+	accumulateForces(t);
+	implicitSolver.solve(particles, springs, particleMass, t.deltaTime, threadPool.get());
+	parallelFor(particles.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			if (particles.inverseMass[i] == 0.f) continue;
+
+			const glm::vec3 position = particles.getPosition(i);
+			const glm::vec3 velocity = (position - particles.getPreviousPosition(i)) / t.deltaTime + implicitSolver.getVelocityChange(i);
+			const glm::vec3 newPosition = position + t.deltaTime * velocity;
+			particles.previousX[i] = position.x;
+			particles.previousY[i] = position.y;
+			particles.previousZ[i] = position.z;
+			particles.x[i] = newPosition.x;
+			particles.y[i] = newPosition.y;
+			particles.z[i] = newPosition.z;
+		}
+	});
+	resolveCollisions(colliders);
+	enforceTethers(colliders);
+}
+
+void Cloth::stepXPBD(const Time& t, const CollisionWorld& colliders)
+{
+	accumulateForces(t, false);
+	predictPositions(t.deltaTime);
+	xpbdSolver.solve(particles, springs, t.deltaTime, threadPool.get());
+	resolveCollisions(colliders);
+	enforceTethers(colliders);
+}
+
+void Cloth::stepProjectiveDynamics(const Time& t, const CollisionWorld& colliders)
+{
+	accumulateForces(t, false);
+	predictPositions(t.deltaTime);
+	if (!projectiveDynamicsSolver.solve(particles, springs, particleMass, t.deltaTime, threadPool.get()))
+	{
+		++solverFailureCount;
+		solverFailed = true;
+	}
+	resolveCollisions(colliders);
+	enforceTethers(colliders);
+}
+
+void Cloth::stepVBD(const Time& t, const CollisionWorld& colliders)
+{
+	accumulateForces(t, false);
+	predictPositions(t.deltaTime);
+	vbdSolver.solve(particles, springs, particleMass, t.deltaTime, threadPool.get());
+	resolveCollisions(colliders);
+	enforceTethers(colliders);
+}
+
+void Cloth::stepMultigrid(const Time& t, const CollisionWorld& colliders)
+{
+	accumulateForces(t, false);
+	predictPositions(t.deltaTime);
+	multigridSolver.solve(particles, springs, particleMass, t.deltaTime, threadPool.get());
+	resolveCollisions(colliders);
+	enforceTethers(colliders);
+}
+
+std::shared_ptr<SubspaceModel> Cloth::trainSubspace(const Time& t, const CollisionWorld& colliders, size_t frameCount, size_t modeCount, size_t cubatureSize)
+{
+	if (restPoseVersion != getTransformVersion())
+		updateRestPositions();
+
+	SubspaceModel::Description description;
+	description.restPositions.resize(particles.size());
+	description.inverseMass.resize(particles.size());
+	for (size_t i = 0; i < particles.size(); ++i)
+	{
+		description.restPositions[i] = particles.getRestPosition(particleSlots[i]);
+		description.inverseMass[i] = particles.inverseMass[particleSlots[i]];
+	}
+	for (size_t s = 0; s < springs.size(); ++s)
+		description.springs.push_back({ particleOrder[springs.particle1[s]], particleOrder[springs.particle2[s]], springs.stiffness[s], springs.restLength[s] });
+	description.mass = particleMass;
+	description.airResistance = airResistance;
+	description.wind = getSubspaceWind();
+
+	Time frame = t;
+	std::vector<SubspaceModel::Snapshot> snapshots(frameCount);
+	for (SubspaceModel::Snapshot& snapshot : snapshots)
+	{
+		updatePhysics(frame, colliders);
+		frame.runningTime += frame.deltaTime;
+		getTranslations(snapshot.displacements);
+		snapshot.velocities.resize(particles.size());
+		for (size_t i = 0; i < particles.size(); ++i)
+		{
+			const uint32_t slot = particleSlots[i];
+			snapshot.velocities[i] = (particles.getPosition(slot) - particles.getPreviousPosition(slot)) / lastSubstepTime;
+		}
+		snapshot.time = frame.runningTime;
+	}
+
+	std::shared_ptr<SubspaceModel> model = std::make_shared<SubspaceModel>();
+	model->build(description, snapshots, modeCount, cubatureSize);
+	return model;
+}
+
+void Cloth::setSubspaceModel(const std::shared_ptr<const SubspaceModel>& model)
+{
+	if (usesSubspace())
+		writeSubspaceState();
+	subspaceModel = model && model->isBuilt() && model->getParticleCount() == particles.size() ? model : nullptr;
+	if (!subspaceModel)
+		return;
+
+	// Particles hold the current state in either case, written back from the previous model if there was one
+	std::vector<glm::vec3> displacements(particles.size()), velocities(particles.size(), glm::vec3(0.f));
+	for (size_t i = 0; i < particles.size(); ++i)
+	{
+		const uint32_t slot = particleSlots[i];
+		displacements[i] = particles.getPosition(slot) - particles.getRestPosition(slot);
+		if (lastSubstepTime > 0.f)
+			velocities[i] = (particles.getPosition(slot) - particles.getPreviousPosition(slot)) / lastSubstepTime;
+	}
+	subspaceModel->project(displacements, velocities, subspaceState);
+}
+
+void Cloth::writeSubspaceState()
+{
+	std::vector<glm::vec3> displacements, velocities;
+	subspaceModel->reconstruct(subspaceState, displacements, &velocities);
+	for (size_t i = 0; i < particles.size(); ++i)
+	{
+		const uint32_t slot = particleSlots[i];
+		const glm::vec3 position = particles.getRestPosition(slot) + displacements[i];
+		const glm::vec3 previous = position - velocities[i] * lastSubstepTime;
+		particles.x[slot] = position.x;
+		particles.y[slot] = position.y;
+		particles.z[slot] = position.z;
+		particles.previousX[slot] = previous.x;
+		particles.previousY[slot] = previous.y;
+		particles.previousZ[slot] = previous.z;
+	}
+	slowForcesValid = false;
+}
+
+void Cloth::stepSubspace(const Time& t)
+{
+	if (subspaceModel)
+		subspaceModel->step(subspaceState, t.deltaTime, t.runningTime, getSubspaceWind());
+}
+
+SubspaceModel::WindFunction Cloth::getSubspaceWind() const
+{
+	if (!wind)
+		return nullptr;
+	return [this](const glm::vec3& position, float time) { return generateWindVector(position, time) * glm::vec3(3.f, 1.f, 3.f); };
+}
+
+void Cloth::predictPositions(float timeStep)
+{
+	// Inertial prediction x + h v + h^2 f / m, with the velocity implied by the previous position
+	parallelFor(particles.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			const float inverseMass = particles.inverseMass[i];
+			if (inverseMass == 0.f) continue;
+
+			const float accelerationFactor = timeStep * timeStep * inverseMass;
+			const float x = particles.x[i], y = particles.y[i], z = particles.z[i];
+			particles.x[i] += x - particles.previousX[i] + accelerationFactor * particles.forceX[i];
+			particles.y[i] += y - particles.previousY[i] + accelerationFactor * particles.forceY[i];
+			particles.z[i] += z - particles.previousZ[i] + accelerationFactor * particles.forceZ[i];
+			particles.previousX[i] = x;
+			particles.previousY[i] = y;
+			particles.previousZ[i] = z;
+		}
+	});
+}
+
+void Cloth::resolveCollisions(const CollisionWorld& colliders)
+{
+	parallelFor(particles.size(), [&](size_t begin, size_t end) { collideParticles(colliders, particles, begin, end); });
+}
+
+void Cloth::collideParticles(const CollisionWorld& colliders, Particles& target, size_t begin, size_t end) const
+{
+	// Broad phase per block of consecutive slots, which are compact patches of the cloth in every particle ordering
+	std::vector<uint32_t> candidates;
+	for (size_t blockBegin = begin; blockBegin < end; blockBegin += collisionBlockSize)
+	{
+		const size_t blockEnd = std::min(blockBegin + collisionBlockSize, end);
+		glm::vec3 boundsMin(std::numeric_limits<float>::max()), boundsMax(-std::numeric_limits<float>::max());
+		for (size_t i = blockBegin; i < blockEnd; ++i)
+		{
+			boundsMin = glm::min(boundsMin, target.getPosition(i));
+			boundsMax = glm::max(boundsMax, target.getPosition(i));
+		}
+		if (sweepStarts.empty())
+			colliders.query(boundsMin, boundsMax, contactOffset, candidates);
+		else
+			colliders.querySwept(sweepStarts, boundsMin, boundsMax, contactOffset, candidates);
+		if (candidates.empty()) continue;
+
+		// The solvers leave the positions from the start of the step in the previous positions
+		for (size_t i = blockBegin; i < blockEnd; ++i)
+		{
+			if (target.inverseMass[i] == 0.f) continue;
+
+			glm::vec3 position = target.getPosition(i);
+			if (sweepStarts.empty())
+				colliders.resolve(candidates.data(), candidates.size(), contactOffset, position);
+			else
+				colliders.resolveSwept(sweepStarts, candidates.data(), candidates.size(), contactOffset, target.getPreviousPosition(i), position);
+			target.x[i] = position.x;
+			target.y[i] = position.y;
+			target.z[i] = position.z;
+		}
+	}
+}
+
+void Cloth::accumulateForces(const Time& t, bool springForces)
+{
+	// Sleeping particles keep their last forces; only rows and springs that reach an awake particle are evaluated
+	const bool stencilForces = springForces && forceKernel == ForceKernel::Stencil && particleOrdering == ParticleOrdering::RowMajor;
+	const uint8_t* particleAwake = usesActiveSet() ? activeSet.getParticleAwake() : nullptr;
+	if (stencilForces)
+	{
+		const StencilForceArgs args{ particles.x.data(), particles.y.data(), particles.z.data(), stencilStiffness, stencilRestLength,
+			particles.forceX.data(), particles.forceY.data(), particles.forceZ.data(), horizontalCount, verticalCount };
+		if (!particleAwake)
+			runStencilKernel(stencilForceKernel, args, 0, verticalCount);
+		else
+		{
+			for (size_t tileRow = 0; tileRow < activeSet.getTileRowCount();)
 			{
-				const glm::vec3 direction = glm::normalize(p.transformedPosition + p.tempTranslation - sphere.getTranslation());
-				p.tempTranslation += direction * (additionalOffset - offset);
+				size_t tileRowEnd = tileRow;
+				while (tileRowEnd < activeSet.getTileRowCount() && activeSet.isTileRowAwake(tileRowEnd))
+					++tileRowEnd;
+				if (tileRowEnd > tileRow)
+					runStencilKernel(stencilForceKernel, args, tileRow * ActiveSet::tileSize, std::min(verticalCount, tileRowEnd * ActiveSet::tileSize));
+				tileRow = tileRowEnd + 1;
 			}
+		}
+	}
+	else if (springForces)
+	{
+		for (size_t b = 0; b < springs.getBatchCount(); ++b)
+			computeSpringBatchForces(b, particleAwake);
+	}
+
+	// Every particle gathers the forces of its own springs, which keeps the pass race free and the summation order fixed.
+	// The stencil also overwrote the sleeping particles in awake tile rows with their spring forces alone; they gather
+	// too, so that every sleeping particle keeps a complete force for the step it wakes up in.
+	parallelFor(particles.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			if (particleAwake && !particleAwake[i] && !(stencilForces && activeSet.isTileRowAwake(i / horizontalCount / ActiveSet::tileSize)))
+				continue;
+
+			glm::vec3 force = computeExternalForce(t, particles, i);
 
-			if (glm::length(p.tempTranslation - translations[i]) < 2.f)
+			if (stencilForces)
+			{
+				force.x += particles.forceX[i];
+				force.y += particles.forceY[i];
+				force.z += particles.forceZ[i];
+			}
+			else if (springForces)
 			{
-				p.previousTranslation = translations[i];
-				translations[i] = p.tempTranslation;
+				for (uint32_t a = springAdjacencyOffsets[i]; a < springAdjacencyOffsets[i + 1]; ++a)
+				{
+					const uint32_t s = springAdjacency[a] >> 1;
+					const float sign = (springAdjacency[a] & 1) ? -1.f : 1.f;
+					force.x += sign * springForceX[s];
+					force.y += sign * springForceY[s];
+					force.z += sign * springForceZ[s];
+				}
 			}
+
+			particles.forceX[i] = force.x;
+			particles.forceY[i] = force.y;
+			particles.forceZ[i] = force.z;
+		}
+	});
+}
+
+void Cloth::runStencilKernel(StencilForceKernel kernel, const StencilForceArgs& args, size_t beginRow, size_t endRow)
+{
+	// Rows are independent, so they are split across the pool in blocks of at least 1024 particles
+	const size_t minRows = std::max<size_t>(1, 1024 / args.width);
+	if (threadPool)
+		threadPool->parallelFor(beginRow, endRow, minRows, [&](size_t begin, size_t end) { kernel(args, begin, end); });
+	else
+		kernel(args, beginRow, endRow);
+}
+
+void Cloth::computeSpringBatchForces(size_t batch, const uint8_t* particleAwake)
+{
+	springForceX.resize(springs.size());
+	springForceY.resize(springs.size());
+	springForceZ.resize(springs.size());
+
+	// Stiffness is loop invariant within a batch. Chunks are whole multiples of the widest vector from the batch
+	// start, so the scalar remainder does not depend on the thread count.
+	constexpr size_t blockSize = 16;
+	const SpringForceArgs args{ particles.x.data(), particles.y.data(), particles.z.data(),
+		springs.particle1.data(), springs.particle2.data(), springs.getBatchStiffness(batch), springs.restLength.data(),
+		springForceX.data(), springForceY.data(), springForceZ.data() };
+	const size_t batchBegin = springs.getBatchBegin(batch);
+	const size_t batchEnd = springs.getBatchEnd(batch);
+	parallelFor((batchEnd - batchBegin + blockSize - 1) / blockSize, [&](size_t begin, size_t end) {
+		if (!particleAwake)
+		{
+			springForceKernel(args, batchBegin + begin * blockSize, std::min(batchBegin + end * blockSize, batchEnd));
+			return;
 		}
 
-		p.tempTranslation = { 0.f, 0.f, 0.f };
-		p.forces = { 0.f, 0.f, 0.f };
+		// Blocks whose springs only join sleeping particles are skipped
+		for (size_t block = begin; block < end; ++block)
+		{
+			const size_t blockBegin = batchBegin + block * blockSize;
+			const size_t blockEnd = std::min(blockBegin + blockSize, batchEnd);
+			bool awake = false;
+			for (size_t s = blockBegin; s < blockEnd && !awake; ++s)
+				awake = particleAwake[springs.particle1[s]] || particleAwake[springs.particle2[s]];
+			if (awake)
+				springForceKernel(args, blockBegin, blockEnd);
+		}
+	});
+}
+
+void Cloth::stepMultirate(const Time& t, const CollisionWorld& colliders)
+{
+	Time fine = t;
+	fine.deltaTime = t.deltaTime / multirateSteps;
+	fine.lastDeltaTime = t.lastDeltaTime / multirateSteps;
+	fine.frameRate = t.frameRate * multirateSteps;
+	if (!slowForcesValid)
+		accumulateMultirateForces(fine, true);
+
+	// Slow forces stay frozen at their value from the start of the coarse step. Air resistance is not one of them:
+	// a collider pushing the cloth within a fine step implies a large velocity, and drag held from it over the
+	// whole coarse step is as many times stiffer as there are fine steps.
+	for (unsigned step = 0; step < multirateSteps; ++step)
+	{
+		integrate(fine, colliders);
+		sweepStarts.clear();
+		accumulateMultirateForces(fine, step + 1 == multirateSteps);
+		fine.lastDeltaTime = fine.deltaTime;
+		fine.runningTime += fine.deltaTime;
+	}
+}
 
-		///////////////////////////// New Calculations ////////////////////////////////////////////////////////////////
-		const glm::vec3 newVelocity = translations[i] - p.previousTranslation;
-		p.transformedPosition = glm::vec3(getTransformMatrix() * glm::vec4(p.initialPosition, 1.f));
-		const glm::vec3 currentPosition = p.transformedPosition + translations[i];
-		p.forces += particleMass * glm::vec3(0.f, -9.81f, 0.f);
-		if (wind) 
-			p.forces += generateWindVector(currentPosition, t.runningTime) * glm::vec3(3.f, 1.f, 3.f);
-		p.forces += generateAirResistanceVector(10.f * t.frameRate * t.frameRate, newVelocity);
+void Cloth::accumulateMultirateForces(const Time& t, bool refreshSlowForces)
+{
+	slowForceX.resize(particles.size());
+	slowForceY.resize(particles.size());
+	slowForceZ.resize(particles.size());
+
+	// Structural and shear springs every fine step. Bending springs only with the slow forces; on the spring list
+	// path their frozen per-spring forces are simply gathered again.
+	const bool stencilForces = forceKernel == ForceKernel::Stencil && particleOrdering == ParticleOrdering::RowMajor;
+	if (stencilForces)
+	{
+		runStencilKernel(getStencilForceKernel(horizontalCount, StencilShape::StructuralShear), { particles.x.data(), particles.y.data(), particles.z.data(),
+			stencilStiffness, stencilRestLength, particles.forceX.data(), particles.forceY.data(), particles.forceZ.data(), horizontalCount, verticalCount }, 0, verticalCount);
+		if (refreshSlowForces)
+		{
+			runStencilKernel(getStencilForceKernel(horizontalCount, StencilShape::Bending), { particles.x.data(), particles.y.data(), particles.z.data(),
+				stencilStiffness + StructuralShearStencil::count, stencilRestLength + StructuralShearStencil::count,
+				slowForceX.data(), slowForceY.data(), slowForceZ.data(), horizontalCount, verticalCount }, 0, verticalCount);
+		}
+	}
+	else
+	{
+		for (size_t b = 0; b < springs.getBatchCount(); ++b)
+		{
+			if (b != Bending || refreshSlowForces)
+				computeSpringBatchForces(b);
+		}
 	}
 
-	for (const auto& spring : springs)
+	parallelFor(particles.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			if (refreshSlowForces)
+			{
+				const glm::vec3 external = computeExternalForce(t, particles, i, false);
+				const glm::vec3 bending = stencilForces ? glm::vec3(slowForceX[i], slowForceY[i], slowForceZ[i]) : glm::vec3(0.f);
+				slowForceX[i] = external.x + bending.x;
+				slowForceY[i] = external.y + bending.y;
+				slowForceZ[i] = external.z + bending.z;
+			}
+
+			glm::vec3 force(slowForceX[i], slowForceY[i], slowForceZ[i]);
+			force += generateAirResistanceVector(airResistance, (particles.getPosition(i) - particles.getPreviousPosition(i)) / t.deltaTime);
+			if (stencilForces)
+			{
+				force.x += particles.forceX[i];
+				force.y += particles.forceY[i];
+				force.z += particles.forceZ[i];
+			}
+			else
+			{
+				for (uint32_t a = springAdjacencyOffsets[i]; a < springAdjacencyOffsets[i + 1]; ++a)
+				{
+					const uint32_t s = springAdjacency[a] >> 1;
+					const float sign = (springAdjacency[a] & 1) ? -1.f : 1.f;
+					force.x += sign * springForceX[s];
+					force.y += sign * springForceY[s];
+					force.z += sign * springForceZ[s];
+				}
+			}
+
+			particles.forceX[i] = force.x;
+			particles.forceY[i] = force.y;
+			particles.forceZ[i] = force.z;
+		}
+	});
+	slowForcesValid = true;
+}
+
+glm::vec3 Cloth::computeExternalForce(const Time& t, const Particles& target, size_t i, bool airDrag) const
+{
+	const glm::vec3 currentPosition = target.getPosition(i);
+	glm::vec3 force = particleMass * glm::vec3(0.f, -9.81f, 0.f);
+	if (wind) 
+		force += generateWindVector(currentPosition, t.runningTime) * glm::vec3(3.f, 1.f, 3.f);
+	if (airDrag)
+		force += generateAirResistanceVector(airResistance, (currentPosition - target.getPreviousPosition(i)) / t.deltaTime);
+	return force;
+}
+
+void Cloth::stepTemporalBlocks(Time& t, const CollisionWorld& colliders, unsigned stepCount)
+{
+	// Every explicit substep only reaches ClothStencil::reach grid cells, so a tile padded with that many ghost
+	// cells per substep can take all of its substeps alone. Tiles are sized to stay cache resident.
+	constexpr size_t tileBytes = 1024 * 1024;
+	constexpr size_t bytesPerParticle = 10 * sizeof(float);
+	const size_t halo = ClothStencil::reach * stepCount;
+	const size_t paddedEdge = (size_t)std::sqrt((float)(tileBytes / bytesPerParticle));
+	const size_t tileEdge = std::max<size_t>(16, paddedEdge > 2 * halo ? paddedEdge - 2 * halo : 0);
+	const size_t tileColumns = (horizontalCount + tileEdge - 1) / tileEdge;
+	const size_t tileRows = (verticalCount + tileEdge - 1) / tileEdge;
+
+	// Tiles read their halos from particles, so results go to a second buffer that is swapped in at the end
+	tileResults.resize(particles.size());
+	auto advanceTiles = [&](size_t beginTile, size_t endTile) {
+		Particles tile;
+		for (size_t tileIndex = beginTile; tileIndex < endTile; ++tileIndex)
+		{
+			const size_t rowBegin = tileIndex / tileColumns * tileEdge;
+			const size_t columnBegin = tileIndex % tileColumns * tileEdge;
+			const size_t rowEnd = std::min(rowBegin + tileEdge, verticalCount);
+			const size_t columnEnd = std::min(columnBegin + tileEdge, horizontalCount);
+			const size_t paddedRowBegin = rowBegin > halo ? rowBegin - halo : 0;
+			const size_t paddedColumnBegin = columnBegin > halo ? columnBegin - halo : 0;
+			const size_t paddedRowEnd = std::min(rowEnd + halo, verticalCount);
+			const size_t paddedColumnEnd = std::min(columnEnd + halo, horizontalCount);
+			const size_t width = paddedColumnEnd - paddedColumnBegin;
+			const size_t height = paddedRowEnd - paddedRowBegin;
+
+			tile.resize(width * height);
+			for (size_t row = 0; row < height; ++row)
+			{
+				const size_t from = (paddedRowBegin + row) * horizontalCount + paddedColumnBegin;
+				for (std::vector<float> Particles::* component : { &Particles::x, &Particles::y, &Particles::z,
+					&Particles::previousX, &Particles::previousY, &Particles::previousZ,
+					&Particles::forceX, &Particles::forceY, &Particles::forceZ, &Particles::inverseMass })
+					std::copy_n((particles.*component).begin() + from, width, (tile.*component).begin() + row * width);
+			}
+
+			Time local = t;
+			const StencilForceArgs args{ tile.x.data(), tile.y.data(), tile.z.data(), stencilStiffness, stencilRestLength,
+				tile.forceX.data(), tile.forceY.data(), tile.forceZ.data(), width, height };
+			const StencilForceKernel kernel = getStencilForceKernel(width);
+			// The part of the padded tile that is still exact shrinks by the stencil reach with every substep, so
+			// each pass only covers the interior plus what later substeps still read
+			const size_t interiorRowBegin = rowBegin - paddedRowBegin, interiorRowEnd = rowEnd - paddedRowBegin;
+			const size_t interiorColumnBegin = columnBegin - paddedColumnBegin, interiorColumnEnd = columnEnd - paddedColumnBegin;
+			for (unsigned step = 0; step < stepCount; ++step)
+			{
+				const size_t positionMargin = halo - ClothStencil::reach * step;
+				const size_t forceMargin = positionMargin - ClothStencil::reach;
+				const size_t positionRowBegin = interiorRowBegin - std::min(interiorRowBegin, positionMargin);
+				const size_t positionRowEnd = std::min(interiorRowEnd + positionMargin, height);
+				const size_t positionColumnBegin = interiorColumnBegin - std::min(interiorColumnBegin, positionMargin);
+				const size_t positionColumnEnd = std::min(interiorColumnEnd + positionMargin, width);
+				for (size_t row = positionRowBegin; row < positionRowEnd; ++row)
+					integrateParticles(local, colliders, tile, row * width + positionColumnBegin, row * width + positionColumnEnd, nullptr, step == 0);
+
+				const size_t forceRowBegin = interiorRowBegin - std::min(interiorRowBegin, forceMargin);
+				const size_t forceRowEnd = std::min(interiorRowEnd + forceMargin, height);
+				const size_t forceColumnBegin = interiorColumnBegin - std::min(interiorColumnBegin, forceMargin);
+				const size_t forceColumnEnd = std::min(interiorColumnEnd + forceMargin, width);
+				kernel(args, forceRowBegin, forceRowEnd);
+				for (size_t row = forceRowBegin; row < forceRowEnd; ++row)
+				{
+					for (size_t i = row * width + forceColumnBegin; i < row * width + forceColumnEnd; ++i)
+					{
+						const glm::vec3 force = computeExternalForce(local, tile, i);
+						tile.forceX[i] += force.x;
+						tile.forceY[i] += force.y;
+						tile.forceZ[i] += force.z;
+					}
+				}
+
+				local.lastDeltaTime = local.deltaTime;
+				local.runningTime += local.deltaTime;
+			}
+
+			// Only the tile interior is exact; the halo was overtaken by the missing cells beyond it
+			for (size_t row = rowBegin; row < rowEnd; ++row)
+			{
+				const size_t from = (row - paddedRowBegin) * width + columnBegin - paddedColumnBegin;
+				const size_t to = row * horizontalCount + columnBegin;
+				for (std::vector<float> Particles::* component : { &Particles::x, &Particles::y, &Particles::z,
+					&Particles::previousX, &Particles::previousY, &Particles::previousZ,
+					&Particles::forceX, &Particles::forceY, &Particles::forceZ })
+					std::copy_n((tile.*component).begin() + from, columnEnd - columnBegin, (tileResults.*component).begin() + to);
+			}
+		}
+	};
+
+	if (threadPool)
+		threadPool->parallelFor(0, tileColumns * tileRows, 1, advanceTiles);
+	else
+		advanceTiles(0, tileColumns * tileRows);
+
+	for (std::vector<float> Particles::* component : { &Particles::x, &Particles::y, &Particles::z,
+		&Particles::previousX, &Particles::previousY, &Particles::previousZ, &Particles::forceX, &Particles::forceY, &Particles::forceZ })
+		(particles.*component).swap(tileResults.*component);
+
+	for (unsigned step = 0; step < stepCount; ++step)
 	{
-		Cloth::Particle& p1 = particles[spring.particle1];
-		Cloth::Particle& p2 = particles[spring.particle2];
-		const float initialSpringLen = glm::length(p2.transformedPosition - p1.transformedPosition);
-		const glm::vec3 p1Position = p1.transformedPosition + translations[spring.particle1];
-		const glm::vec3 p2Position = p2.transformedPosition + translations[spring.particle2];
-		const float currentSpringLen = glm::length(p2Position - p1Position);
-		const glm::vec3 springForce = springConstants[spring.type] * (currentSpringLen - initialSpringLen) * glm::normalize(p2Position - p1Position);
-		p1.forces += springForce;
-		p2.forces -= springForce;
+		t.lastDeltaTime = t.deltaTime;
+		t.runningTime += t.deltaTime;
 	}
 }
 
-void Cloth::constructModel(size_t horizontalCount, size_t verticalCount) 
+void Cloth::parallelFor(size_t count, const std::function<void(size_t, size_t)>& body) const
 {
-	particles.reserve(verticesCount);
-	springs.reserve(8 * verticesCount - 5 * horizontalCount - 5 * verticalCount + 4);
-	translations.reserve(verticesCount);
-	std::vector<GLuint> indices;
-	indices.reserve(indicesCount);
-	std::vector<float> data;
-	data.reserve(verticalCount * 8);
+	::parallelFor(threadPool.get(), count, body);
+}
+
+void Cloth::constructModel()
+{
+	const size_t verticesCount = horizontalCount * verticalCount;
+	particles.resize(verticesCount);
+	initialPositions.reserve(verticesCount);
+	indices.reserve((horizontalCount - 1) * (verticalCount - 1) * 6);
 	float xDelta = 1.f / horizontalCount;
 	float yDelta = 1.f / verticalCount;
 
@@ -100,24 +1186,14 @@ void Cloth::constructModel(size_t horizontalCount, size_t verticalCount)
 	{
 		for (size_t j = 0; j < horizontalCount; ++j)
 		{
-			// Position
-			data.push_back(-0.5f + j * xDelta);
-			data.push_back(0.5f - i * yDelta);
-			data.push_back(0.f);
-
-			// Normal
-			data.push_back(0.f);
-			data.push_back(0.f);
-			data.push_back(1.f);
-
-			// Texture coordinates
-			data.push_back(0.f + j * xDelta);
-			data.push_back(1.f - i * yDelta);
-
 			// Cloth vertex
-			particles.push_back(Cloth::Particle(glm::vec3(-0.5f + j * xDelta, 0.5f - i * yDelta, 0.f)));
+			const size_t index = i * horizontalCount + j;
+			initialPositions.push_back(glm::vec3(-0.5f + j * xDelta, 0.5f - i * yDelta, 0.f));
+			particles.x[index] = particles.previousX[index] = particles.restX[index] = initialPositions.back().x;
+			particles.y[index] = particles.previousY[index] = particles.restY[index] = initialPositions.back().y;
+			particles.z[index] = particles.previousZ[index] = particles.restZ[index] = initialPositions.back().z;
+			particles.inverseMass[index] = 1.f / particleMass;
 
-			translations.push_back(glm::vec3(0.f, 0.f, 0.f));
 			if (j > 0 && i > 0)
 			{
 				indices.push_back((i - 1) * horizontalCount + j - 1);
@@ -128,45 +1204,86 @@ void Cloth::constructModel(size_t horizontalCount, size_t verticalCount)
 				indices.push_back((i - 1) * horizontalCount + j - 1);
 
 				// Cloth springs --> point connected to each adjacent point and second next vertically and horizontally
-				springs.push_back(Cloth::Spring((i - 1) * horizontalCount + j - 1, i * horizontalCount + j - 1, Cloth::Structural));
-				springs.push_back(Cloth::Spring((i - 1) * horizontalCount + j - 1, (i - 1) * horizontalCount + j, Cloth::Structural));
-				springs.push_back(Cloth::Spring((i - 1) * horizontalCount + j - 1, i * horizontalCount + j, Cloth::Shear));
-				springs.push_back(Cloth::Spring((i - 1) * horizontalCount + j, i * horizontalCount + j - 1, Cloth::Shear));
+				addSpring((i - 1) * horizontalCount + j - 1, i * horizontalCount + j - 1, Cloth::Structural);
+				addSpring((i - 1) * horizontalCount + j - 1, (i - 1) * horizontalCount + j, Cloth::Structural);
+				addSpring((i - 1) * horizontalCount + j - 1, i * horizontalCount + j, Cloth::Shear);
+				addSpring((i - 1) * horizontalCount + j, i * horizontalCount + j - 1, Cloth::Shear);
 				if (i == verticalCount - 1)
-					springs.push_back(Cloth::Spring(i * horizontalCount + j - 1, i * horizontalCount + j, Cloth::Structural));
+					addSpring(i * horizontalCount + j - 1, i * horizontalCount + j, Cloth::Structural);
 				if (j == horizontalCount - 1)
-					springs.push_back(Cloth::Spring((i - 1) * horizontalCount + j, i * horizontalCount + j, Cloth::Structural));
+					addSpring((i - 1) * horizontalCount + j, i * horizontalCount + j, Cloth::Structural);
 
 				if (j > 1 && i > 1)
 				{
-					springs.push_back(Cloth::Spring((i - 2) * horizontalCount + j - 2, (i - 2) * horizontalCount + j, Cloth::Bending));
-					springs.push_back(Cloth::Spring((i - 2) * horizontalCount + j - 2, i * horizontalCount + j - 2, Cloth::Bending));
+					addSpring((i - 2) * horizontalCount + j - 2, (i - 2) * horizontalCount + j, Cloth::Bending);
+					addSpring((i - 2) * horizontalCount + j - 2, i * horizontalCount + j - 2, Cloth::Bending);
 					if (i == verticalCount - 1 || i == verticalCount - 2)
-						springs.push_back(Cloth::Spring(i * horizontalCount + j - 2, i * horizontalCount + j, Cloth::Bending));
+						addSpring(i * horizontalCount + j - 2, i * horizontalCount + j, Cloth::Bending);
 					if (j == horizontalCount - 1 || j == horizontalCount - 2)
-						springs.push_back(Cloth::Spring((i - 2) * horizontalCount + j, i * horizontalCount + j, Cloth::Bending));
+						addSpring((i - 2) * horizontalCount + j, i * horizontalCount + j, Cloth::Bending);
 				}
 			}
 		}
 	}
 
-	particles[0].fixed = true;
-	particles[49].fixed = true;
-
-	glGenBuffers(1, &ebo);
-	glBindVertexArray(vao);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), data.data(), GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), 0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (GLvoid*)sizeof(glm::vec3));
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (GLvoid*)(2 * sizeof(glm::vec3)));
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	springs.buildBatches(springConstants);
+	particleOrder.resize(verticesCount);
+	particleSlots.resize(verticesCount);
+	for (size_t i = 0; i < verticesCount; ++i)
+		particleOrder[i] = particleSlots[i] = (uint32_t)i;
+	activeSet.initialize(horizontalCount, verticalCount, particleSlots);
+
+	stencilForceKernel = getStencilForceKernel(horizontalCount);
+	for (size_t o = 0; o < ClothStencil::count; ++o)
+		stencilStiffness[o] = springConstants[ClothStencil::offsets[o].type];
+
+	particles.inverseMass[0] = 0.f;
+	particles.inverseMass[horizontalCount - 1] = 0.f;
+
+	buildSpringAdjacency();
+	updateRestPositions();
+}
+
+void Cloth::addSpring(size_t p1, size_t p2, SpringConstantType type)
+{
+	springs.add((uint32_t)p1, (uint32_t)p2, (uint8_t)type);
+}
+
+void Cloth::buildSpringAdjacency()
+{
+	springAdjacencyOffsets.assign(particles.size() + 1, 0);
+	for (size_t s = 0; s < springs.size(); ++s)
+	{
+		++springAdjacencyOffsets[springs.particle1[s] + 1];
+		++springAdjacencyOffsets[springs.particle2[s] + 1];
+	}
+
+	for (size_t i = 0; i < particles.size(); ++i)
+		springAdjacencyOffsets[i + 1] += springAdjacencyOffsets[i];
+
+	std::vector<uint32_t> fill(springAdjacencyOffsets.begin(), springAdjacencyOffsets.end() - 1);
+	springAdjacency.resize(2 * springs.size());
+	for (size_t s = 0; s < springs.size(); ++s)
+	{
+		springAdjacency[fill[springs.particle1[s]]++] = (uint32_t)s << 1;
+		springAdjacency[fill[springs.particle2[s]]++] = ((uint32_t)s << 1) | 1;
+	}
+
+	// Largest total stiffness on a particle over its mass, for the stable timestep estimate, also split into the
+	// stiff and the bending springs for multirate stepping
+	maxStiffnessPerMass = maxFastStiffnessPerMass = maxSlowStiffnessPerMass = 0.f;
+	for (size_t i = 0; i < particles.size(); ++i)
+	{
+		float fastStiffness = 0.f, slowStiffness = 0.f;
+		for (uint32_t a = springAdjacencyOffsets[i]; a < springAdjacencyOffsets[i + 1]; ++a)
+		{
+			const uint32_t s = springAdjacency[a] >> 1;
+			(springs.getBatch(s) == Bending ? slowStiffness : fastStiffness) += springs.stiffness[s];
+		}
+		maxStiffnessPerMass = std::max(maxStiffnessPerMass, (fastStiffness + slowStiffness) / particleMass);
+		maxFastStiffnessPerMass = std::max(maxFastStiffnessPerMass, fastStiffness / particleMass);
+		maxSlowStiffnessPerMass = std::max(maxSlowStiffnessPerMass, slowStiffness / particleMass);
+	}
 }
 
 glm::vec3 Cloth::generateWindVector(const glm::vec3& factor, const float time) const
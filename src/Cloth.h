@@ -1,44 +1,286 @@
 #pragma once
-#include "Entity.h"
-#include "Sphere.h"
-#include "Window.h"
+#include "Transformable.h"
+#include "CollisionWorld.h"
+#include "Time.h"
+#include "Particles.h"
+#include "Springs.h"
+#include "SpringKernels.h"
+#include "StencilKernels.h"
+#include "ThreadPool.h"
+#include "ImplicitSolver.h"
+#include "XPBDSolver.h"
+#include "ProjectiveDynamicsSolver.h"
+#include "VBDSolver.h"
+#include "MultigridSolver.h"
+#include "GraphOrdering.h"
+#include "ActiveSet.h"
+#include "SubspaceModel.h"
+#include "SelfCollision.h"
 #include <vector>
+#include <cstdint>
+#include <memory>
 
-class Cloth : public Entity {
+class Cloth : public Transformable {
 public:
 	Cloth(size_t horizontalCount, size_t verticalCount);
-	~Cloth() override;
-	void draw() const override;
-	void updatePhysics(const Time& t, const Sphere& s);
-	const std::vector<glm::vec3>& getTranslations() const { return translations; }
+	void updatePhysics(const Time& t, const CollisionWorld& colliders);
+	void getTranslations(std::vector<glm::vec3>& translations) const;
+	const std::vector<uint32_t>& getIndices() const { return indices; }
+	const glm::vec3& getRestPosition(size_t index) const { return initialPositions[index]; }
+	size_t getParticleCount() const { return particles.size(); }
+	size_t getHorizontalCount() const { return horizontalCount; }
+	size_t getVerticalCount() const { return verticalCount; }
+	void setSimdLevel(SimdLevel level);
+	SimdLevel getSimdLevel() const { return simdLevel; }
+	void setThreadPool(const std::shared_ptr<ThreadPool>& pool) { threadPool = pool; }
 	enum SpringConstantType { Structural, Shear, Bending };
 
-private:
-	struct Particle {
-		Particle(const glm::vec3& initPosition) : initialPosition(initPosition) {}
-		const glm::vec3 initialPosition;
-		glm::vec3 tempTranslation{ 0.f, 0.f, 0.f };
-		glm::vec3 previousTranslation{ 0.f, 0.f, 0.f };
-		glm::vec3 forces{ 0.f, 0.f, 0.f };
-		glm::vec3 transformedPosition{ 0.f, 0.f, 0.f };
-		bool fixed = false;
+	// Spring forces either from the generic spring list or from a grid stencil that needs no per-spring data
+	enum class ForceKernel {
+		SpringList,
+		Stencil
+	};
+
+	void setForceKernel(ForceKernel kernel) { forceKernel = kernel; }
+	ForceKernel getForceKernel() const { return forceKernel; }
+
+	// Memory order of the particles. Indices seen from outside, by the renderer and getTranslations, always stay
+	// the original row-major ones. The stencil force kernel needs the row-major layout and is skipped otherwise.
+	enum class ParticleOrdering {
+		RowMajor,
+		Morton,			// Z-order curve through the rest positions
+		ReverseCuthillMcKee	// Bandwidth-reducing order of the spring graph
 	};
 
-	struct Spring {
-		Spring(size_t p1, size_t p2, SpringConstantType _type) : particle1(p1), particle2(p2), type(_type) {}
-		size_t particle1, particle2;
-		SpringConstantType type;
+	void setParticleOrdering(ParticleOrdering ordering);
+	ParticleOrdering getParticleOrdering() const { return particleOrdering; }
+
+	enum class Solver {
+		Explicit,	// Verlet integration of the spring forces
+		Implicit,	// Backward Euler, solved with preconditioned conjugate gradients
+		XPBD,		// Springs as compliant distance constraints, projected with colored Gauss-Seidel
+		ProjectiveDynamics,	// Local spring projections alternated with a prefactored global solve
+		VBD,		// Vertex block descent, per-particle Newton steps over a grid vertex coloring
+		Multigrid,	// Vertex block descent on a hierarchy of coarser grids, prolongated and smoothed level by level
+		Subspace	// Reduced coordinates in a basis trained from full simulations, see SubspaceModel
 	};
 
-	void constructModel(size_t horizontalCount, size_t verticalCount);
+	void setSolver(Solver solver);
+	Solver getSolver() const { return solver; }
+	ImplicitSolver& getImplicitSolver() { return implicitSolver; }
+	XPBDSolver& getXPBDSolver() { return xpbdSolver; }
+	ProjectiveDynamicsSolver& getProjectiveDynamicsSolver() { return projectiveDynamicsSolver; }
+	VBDSolver& getVBDSolver() { return vbdSolver; }
+	MultigridSolver& getMultigridSolver() { return multigridSolver; }
+
+	// Every updatePhysics call is split into this many equal substeps
+	void setSubstepCount(unsigned count) { substepCount = count > 0 ? count : 1; }
+	unsigned getSubstepCount() const { return substepCount; }
+
+	// Multirate explicit stepping: every substep is split into this many fine steps for the structural and shear
+	// springs and the air resistance, while bending springs, gravity and wind are evaluated once per substep and held.
+	// 0 or 1 integrates everything at the substep rate.
+	void setMultirateSteps(unsigned steps) { multirateSteps = steps; slowForcesValid = false; }
+	unsigned getMultirateSteps() const { return multirateSteps; }
+
+	// Adaptive stepping: every frame gets as many substeps as the estimated stability limit of the explicit solver
+	// asks for, never fewer than getSubstepCount(). A frame whose energy spikes or whose springs overstretch is
+	// rolled back and retried with half the substep length.
+	void setAdaptiveTimeStep(bool enabled) { adaptiveTimeStep = enabled; }
+	bool isAdaptiveTimeStep() const { return adaptiveTimeStep; }
+	float getStableTimeStep() const { return estimateStableTimeStep(); }
+	unsigned getLastSubstepCount() const { return lastSubstepCount; }
+	unsigned getRollbackCount() const { return rollbackCount; }
+
+	// Substeps whose solver failed, such as a projective dynamics matrix that could not be factored. Such a substep
+	// leaves the cloth at its inertial prediction; the adaptive controller rolls the frame back like a divergence.
+	unsigned getSolverFailureCount() const { return solverFailureCount; }
+
+	// Temporal blocking for the explicit stencil path: substeps are taken in groups of this many, each group tile by
+	// tile on cache-resident tiles with ghost halos. 0 or 1 steps the whole cloth once per substep, and so do tethers
+	// and self-collision.
+	void setTemporalBlocking(unsigned substeps) { substepsPerTile = substeps; }
+	unsigned getTemporalBlocking() const { return substepsPerTile; }
+
+	// Sleeping: tiles of the cloth that have rested for a while drop out of the simulation until a neighbour, the
+	// collider or a change of the wind disturbs them, see ActiveSet. Only the plain explicit solver, without multirate
+	// or temporal blocking, lets tiles sleep; every other mode keeps the whole cloth awake. A cloth that moves all
+	// over, as in the wind, is only checked for resting tiles every few steps and costs about as much as without.
+	void setSleeping(bool enabled);
+	bool isSleeping() const { return sleeping; }
+	size_t getTileCount() const { return activeSet.getTileCount(); }
+	size_t getAwakeTileCount() const { return activeSet.getAwakeTiles().size(); }
+
+	void setWind(bool enabled) { wind = enabled; }
+	bool isWindEnabled() const { return wind; }
+
+	// Long-range attachments: every free particle is kept within its geodesic rest distance to the nearest pin,
+	// stretched by the given fraction, after every substep of every full-space solver; they turn temporal blocking
+	// off, and the subspace model, whose reduced coordinates cannot follow them, ignores them. Stretch away from the
+	// pins then no longer has to travel through the springs one particle per iteration.
+	void setTethers(bool enabled) { tethers = enabled; }
+	bool hasTethers() const { return tethers; }
+	void setTetherStretch(float stretch) { tetherStretch = stretch; }
+	float getTetherStretch() const { return tetherStretch; }
+
+	// Self-collision: after every substep of every full-space solver, particles that no spring connects are pushed
+	// apart to at least half the rest spacing of the grid, see SelfCollision. It turns temporal blocking off.
+	void setSelfCollision(bool enabled);
+	bool hasSelfCollision() const { return selfCollision; }
+	size_t getSelfContactCount() const { return selfCollider.getContactCount(); }
+
+	// Continuous collision: spheres that moved since the last substep are swept against the particle trajectories of
+	// the next one instead of only being tested where they end up, see CollisionWorld::resolveSwept
+	void setContinuousCollision(bool enabled);
+	bool hasContinuousCollision() const { return continuousCollision; }
+
+	// Simulates frameCount frames with the current solver from the current state and builds a subspace model from
+	// them. Cloths that share the model need this cloth's particle count and transform.
+	std::shared_ptr<SubspaceModel> trainSubspace(const Time& t, const CollisionWorld& colliders, size_t frameCount, size_t modeCount, size_t cubatureSize);
+
+	// The Subspace solver steps this model, into which setting it projects the current state. Switching to another
+	// solver writes the reduced state back to the particles.
+	void setSubspaceModel(const std::shared_ptr<const SubspaceModel>& model);
+	const std::shared_ptr<const SubspaceModel>& getSubspaceModel() const { return subspaceModel; }
+
+private:
+	void constructModel();
+	void addSpring(size_t p1, size_t p2, SpringConstantType type);
+	void buildSpringAdjacency();
+	void initializeSolvers(bool topologyChanged = false);
+	void parallelFor(size_t count, const std::function<void(size_t, size_t)>& body) const;
+	void updateRestPositions();
+	void advance(const Time& t, const CollisionWorld& colliders, unsigned count);
+	float estimateStableTimeStep() const;
+	bool checkDivergence(float timeStep);
+	void saveState();
+	void restoreState();
+	void stepMultirate(const Time& t, const CollisionWorld& colliders);
+	void accumulateMultirateForces(const Time& t, bool refreshSlowForces);
+	void runStencilKernel(StencilForceKernel kernel, const StencilForceArgs& args, size_t beginRow, size_t endRow);
+	void computeSpringBatchForces(size_t batch, const uint8_t* particleAwake = nullptr);
+	bool usesActiveSet() const;
+	bool usesTemporalBlocking() const;
+	void updateActiveSet(const Time& t, const CollisionWorld& colliders);
+	bool isSleepTracked();
+	void integrate(const Time& t, const CollisionWorld& colliders, bool trackSleep = false);
+	struct Motion {
+		float maxDisplacementSquared = 0.f;
+		float maxDisplacementChangeSquared = 0.f;
+	};
+	void integrateParticles(const Time& t, const CollisionWorld& colliders, Particles& target, size_t begin, size_t end, Motion* motion = nullptr, bool swept = true) const;
+	void stepTemporalBlocks(Time& t, const CollisionWorld& colliders, unsigned stepCount);
+	void stepImplicit(const Time& t, const CollisionWorld& colliders);
+	void stepXPBD(const Time& t, const CollisionWorld& colliders);
+	void stepProjectiveDynamics(const Time& t, const CollisionWorld& colliders);
+	void stepVBD(const Time& t, const CollisionWorld& colliders);
+	void stepMultigrid(const Time& t, const CollisionWorld& colliders);
+	void stepSubspace(const Time& t);
+	bool usesSubspace() const { return solver == Solver::Subspace && subspaceModel; }
+	void writeSubspaceState();
+	SubspaceModel::WindFunction getSubspaceWind() const;
+	void predictPositions(float timeStep);
+	void resolveCollisions(const CollisionWorld& colliders);
+	void collideParticles(const CollisionWorld& colliders, Particles& target, size_t begin, size_t end) const;
+	void buildTethers();
+	void enforceTethers(const CollisionWorld& colliders);
+	bool projectOntoTether(const CollisionWorld& colliders, size_t i, glm::vec3& position) const;
+	void accumulateForces(const Time& t, bool springForces = true);
+	glm::vec3 computeExternalForce(const Time& t, const Particles& target, size_t i, bool airDrag = true) const;
 	glm::vec3 generateWindVector(const glm::vec3& factor, const float time) const;
 	glm::vec3 generateAirResistanceVector(const float factor, const glm::vec3& velocity) const;
-	std::vector<Spring> springs;
-	std::vector<Particle> particles;
-	std::vector<glm::vec3> translations;
+	Springs springs;
+	std::vector<float> springForceX, springForceY, springForceZ;
+
+	// CSR list of the springs incident to each particle. Entries are (spring index << 1) | 1 when the
+	// particle is the spring's second endpoint, so forces can be gathered per particle without atomics.
+	std::vector<uint32_t> springAdjacencyOffsets;
+	std::vector<uint32_t> springAdjacency;
+	Particles particles;
+	std::vector<glm::vec3> initialPositions;
+
+	// Original index of the particle in every memory slot, and the slot of every original index
+	ParticleOrdering particleOrdering = ParticleOrdering::RowMajor;
+	std::vector<uint32_t> particleOrder;
+	std::vector<uint32_t> particleSlots;
+	std::vector<uint32_t> indices;
+	size_t horizontalCount = 0;
+	size_t verticalCount = 0;
 	float particleMass = 1.f;
 	bool wind = true;
+	float airResistance = 10.f;
 	float springConstants[3] = { 6000.f, 2000.f, 100.f };
-	GLuint ebo = 0;
-	size_t indicesCount = 0;
-};
\ No newline at end of file
+
+	// Particles are tested against the collision world in blocks of this many consecutive slots
+	static constexpr size_t collisionBlockSize = 64;
+
+	// Rest positions, rest lengths and the contact offset only depend on the transform
+	uint64_t restPoseVersion = 0;
+	float contactOffset = 0.f;
+	SimdLevel simdLevel = getSupportedSimdLevel();
+	SpringForceKernel springForceKernel = getSpringForceKernel(simdLevel);
+	ForceKernel forceKernel = ForceKernel::Stencil;
+	StencilForceKernel stencilForceKernel = nullptr;
+	float stencilStiffness[ClothStencil::count] = {};
+	float stencilRestLength[ClothStencil::count] = {};
+	std::shared_ptr<ThreadPool> threadPool;
+	Solver solver = Solver::Explicit;
+	unsigned substepCount = 1;
+	unsigned substepsPerTile = 0;
+	unsigned multirateSteps = 0;
+	bool slowForcesValid = false;
+	std::vector<float> slowForceX, slowForceY, slowForceZ;
+	float lastSubstepTime = 0.f;
+	unsigned lastSubstepCount = 1;
+
+	// Adaptive step controller. The safety factor on the stable step halves on every rollback and recovers slowly.
+	bool adaptiveTimeStep = false;
+	static constexpr unsigned maxAdaptiveSubsteps = 64;
+	static constexpr float maxStepSafety = 0.7f;
+	static constexpr float minStepSafety = 0.05f;
+	static constexpr float maxStrain = 1.f;
+	static constexpr double energySpikeFactor = 10.0;
+	float stepSafety = maxStepSafety;
+	float maxStiffnessPerMass = 0.f;
+	float maxFastStiffnessPerMass = 0.f;
+	float maxSlowStiffnessPerMass = 0.f;
+	float lastMaxSpeed = 0.f;
+	double lastKineticEnergy = 0.0;
+	unsigned rollbackCount = 0;
+	unsigned solverFailureCount = 0;
+	bool solverFailed = false;
+	Particles rollbackState;
+	float rollbackSubstepTime = 0.f;
+
+	// Pin slot and geodesic rest distance per slot; pins and particles no pin reaches have no tether
+	bool tethers = false;
+	float tetherStretch = 0.1f;
+	static constexpr uint32_t noTether = UINT32_MAX;
+	std::vector<uint32_t> tetherAnchors;
+	std::vector<float> tetherLengths;
+
+	bool selfCollision = false;
+	float selfCollisionDistance = 0.f;
+	SelfCollision selfCollider;
+
+	// Sphere centers at the end of the last advance, swept from by the first integration of the next one and cleared
+	// after it; empty while there is nothing to sweep from
+	bool continuousCollision = false;
+	std::vector<glm::vec3> sweepStarts;
+	std::vector<glm::vec3> rollbackSweepStarts;
+
+	// Sleeping tiles wake up when the external force on them changes by more than this acceleration
+	bool sleeping = false;
+	static constexpr float wakeAcceleration = 1.f;
+	static constexpr unsigned sleepProbeInterval = 16;
+	unsigned stepsSinceSleepProbe = 0;
+	ActiveSet activeSet;
+	Particles tileResults;
+	ImplicitSolver implicitSolver;
+	XPBDSolver xpbdSolver;
+	ProjectiveDynamicsSolver projectiveDynamicsSolver;
+	VBDSolver vbdSolver;
+	MultigridSolver multigridSolver;
+	std::shared_ptr<const SubspaceModel> subspaceModel;
+	SubspaceModel::State subspaceState;
+};
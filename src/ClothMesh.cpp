@@ -0,0 +1,60 @@
+#include "ClothMesh.h"
+#include <vector>
+
+ClothMesh::ClothMesh(const Cloth& cloth)
+{
+	verticesCount = (GLuint)cloth.getParticleCount();
+	indicesCount = (GLuint)cloth.getIndices().size();
+	constructModel(cloth);
+}
+
+ClothMesh::~ClothMesh()
+{
+	glDeleteBuffers(1, &ebo);
+}
+
+void ClothMesh::draw() const
+{
+	glBindVertexArray(vao);
+	glDrawElements(GL_TRIANGLES, indicesCount, GL_UNSIGNED_INT, nullptr);
+	glBindVertexArray(0);
+}
+
+void ClothMesh::constructModel(const Cloth& cloth)
+{
+	std::vector<float> data;
+	data.reserve(verticesCount * 8);
+	for (size_t i = 0; i < verticesCount; ++i)
+	{
+		const glm::vec3& position = cloth.getRestPosition(i);
+
+		// Position
+		data.push_back(position.x);
+		data.push_back(position.y);
+		data.push_back(position.z);
+
+		// Normal
+		data.push_back(0.f);
+		data.push_back(0.f);
+		data.push_back(1.f);
+
+		// Texture coordinates
+		data.push_back(position.x + 0.5f);
+		data.push_back(position.y + 0.5f);
+	}
+
+	glGenBuffers(1, &ebo);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), data.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesCount * sizeof(GLuint), cloth.getIndices().data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), 0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (GLvoid*)sizeof(glm::vec3));
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (GLvoid*)(2 * sizeof(glm::vec3)));
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "Entity.h"
+#include "Cloth.h"
+
+class ClothMesh : public Entity {
+public:
+	ClothMesh(const Cloth& cloth);
+	~ClothMesh() override;
+	void draw() const override;
+
+private:
+	void constructModel(const Cloth& cloth);
+	GLuint ebo = 0;
+	GLuint indicesCount = 0;
+};
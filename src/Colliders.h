@@ -0,0 +1,49 @@
+#pragma once
+#include <glm/vec3.hpp>
+#include <glm/mat3x3.hpp>
+#include <memory>
+#include <vector>
+
+class SignedDistanceField;
+class TriangleMeshBvh;
+
+struct SphereCollider {
+	glm::vec3 center{ 0.f };
+	float radius = 1.f;
+};
+
+// Segment a .. b swept by a sphere
+struct CapsuleCollider {
+	glm::vec3 a{ 0.f };
+	glm::vec3 b{ 0.f };
+	float radius = 1.f;
+};
+
+// Oriented box; the columns of orientation are its orthonormal local axes
+struct BoxCollider {
+	glm::vec3 center{ 0.f };
+	glm::vec3 halfExtents{ 1.f };
+	glm::mat3 orientation{ 1.f };
+};
+
+// Solid half-space below the plane dot(normal, x) = offset, with a unit normal
+struct PlaneCollider {
+	glm::vec3 normal{ 0.f, 1.f, 0.f };
+	float offset = 0.f;
+};
+
+// Static mesh as a signed distance field, placed rigidly in the world; the columns of orientation are the
+// field's orthonormal axes
+struct DistanceFieldCollider {
+	std::shared_ptr<const SignedDistanceField> field;
+	glm::vec3 position{ 0.f };
+	glm::mat3 orientation{ 1.f };
+};
+
+// Triangle mesh in the pose given by its vertices, for meshes that deform from frame to frame. The hierarchy over its
+// triangles is built once and only refit to each pose. Particles up to depth behind the surface are still pushed out.
+struct TriangleMeshCollider {
+	std::shared_ptr<const TriangleMeshBvh> bvh;
+	std::vector<glm::vec3> vertices;
+	float depth = 0.2f;
+};
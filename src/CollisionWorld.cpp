@@ -0,0 +1,318 @@
+#include "CollisionWorld.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+void CollisionWorld::add(const SphereCollider& sphere)
+{
+	colliders.push_back({ Shape::Sphere, (uint32_t)spheres.size(), sphere.center - glm::vec3(sphere.radius), sphere.center + glm::vec3(sphere.radius) });
+	spheres.push_back(sphere);
+}
+
+void CollisionWorld::add(const CapsuleCollider& capsule)
+{
+	colliders.push_back({ Shape::Capsule, (uint32_t)capsules.size(), glm::min(capsule.a, capsule.b) - glm::vec3(capsule.radius),
+		glm::max(capsule.a, capsule.b) + glm::vec3(capsule.radius) });
+	capsules.push_back(capsule);
+}
+
+void CollisionWorld::add(const BoxCollider& box)
+{
+	// Extent of the rotated box along each world axis
+	glm::vec3 extent(0.f);
+	for (int axis = 0; axis < 3; ++axis)
+		extent += glm::abs(box.orientation[axis]) * box.halfExtents[axis];
+	colliders.push_back({ Shape::Box, (uint32_t)boxes.size(), box.center - extent, box.center + extent });
+	boxes.push_back(box);
+}
+
+void CollisionWorld::add(const DistanceFieldCollider& distanceField)
+{
+	if (!distanceField.field || !distanceField.field->isBuilt())
+		return;
+
+	// Bounds of the rotated grid box, as for a box collider
+	const glm::vec3 center = (distanceField.field->getBoundsMin() + distanceField.field->getBoundsMax()) * 0.5f;
+	const glm::vec3 halfExtents = (distanceField.field->getBoundsMax() - distanceField.field->getBoundsMin()) * 0.5f;
+	const glm::vec3 worldCenter = distanceField.position + distanceField.orientation * center;
+	glm::vec3 extent(0.f);
+	for (int axis = 0; axis < 3; ++axis)
+		extent += glm::abs(distanceField.orientation[axis]) * halfExtents[axis];
+	colliders.push_back({ Shape::DistanceField, (uint32_t)distanceFields.size(), worldCenter - extent, worldCenter + extent });
+	distanceFields.push_back(distanceField);
+}
+
+void CollisionWorld::add(const TriangleMeshCollider& mesh)
+{
+	if (!mesh.bvh || !mesh.bvh->isBuilt() || mesh.vertices.size() != mesh.bvh->getVertexCount())
+		return;
+
+	// Refit rather than rebuilt for every pose; the root bounds, grown by the depth, are the mesh's bounds
+	Mesh entry{ mesh.bvh, TriangleMeshBvh::Pose(), mesh.depth };
+	mesh.bvh->refit(mesh.vertices, entry.pose);
+	colliders.push_back({ Shape::TriangleMesh, (uint32_t)meshes.size(), entry.pose.boundsMin[0] - glm::vec3(mesh.depth),
+		entry.pose.boundsMax[0] + glm::vec3(mesh.depth) });
+	meshes.push_back(std::move(entry));
+}
+
+void CollisionWorld::add(const PlaneCollider& plane)
+{
+	colliders.push_back({ Shape::Plane, (uint32_t)planes.size(), glm::vec3(0.f), glm::vec3(0.f) });
+	planes.push_back(plane);
+}
+
+void CollisionWorld::clear()
+{
+	colliders.clear();
+	spheres.clear();
+	capsules.clear();
+	boxes.clear();
+	planes.clear();
+	distanceFields.clear();
+	meshes.clear();
+}
+
+void CollisionWorld::query(const glm::vec3& min, const glm::vec3& max, float margin, std::vector<uint32_t>& result) const
+{
+	result.clear();
+	for (uint32_t c = 0; c < colliders.size(); ++c)
+	{
+		if (overlaps(c, min, max, margin))
+			result.push_back(c);
+	}
+}
+
+bool CollisionWorld::overlaps(uint32_t collider, const glm::vec3& min, const glm::vec3& max, float margin) const
+{
+	const Collider& entry = colliders[collider];
+	if (entry.shape == Shape::Plane)
+	{
+		// The box corner deepest below the plane
+		const PlaneCollider& plane = planes[entry.index];
+		const glm::vec3 corner(plane.normal.x > 0.f ? min.x : max.x, plane.normal.y > 0.f ? min.y : max.y, plane.normal.z > 0.f ? min.z : max.z);
+		return glm::dot(plane.normal, corner) - plane.offset < margin;
+	}
+
+	return entry.boundsMin.x <= max.x + margin && entry.boundsMax.x >= min.x - margin &&
+		entry.boundsMin.y <= max.y + margin && entry.boundsMax.y >= min.y - margin &&
+		entry.boundsMin.z <= max.z + margin && entry.boundsMax.z >= min.z - margin;
+}
+
+void CollisionWorld::resolve(const uint32_t* candidates, size_t count, float contactOffset, glm::vec3& position) const
+{
+	for (size_t c = 0; c < count; ++c)
+		resolve(colliders[candidates[c]], contactOffset, position);
+}
+
+void CollisionWorld::resolve(float contactOffset, glm::vec3& position) const
+{
+	for (const Collider& collider : colliders)
+		resolve(collider, contactOffset, position);
+}
+
+void CollisionWorld::resolve(const Collider& collider, float contactOffset, glm::vec3& position) const
+{
+	switch (collider.shape)
+	{
+		case Shape::Sphere:
+		{
+			const SphereCollider& sphere = spheres[collider.index];
+			const float offset = glm::distance(sphere.center, position) - sphere.radius;
+			if (offset < contactOffset)
+				position += glm::normalize(position - sphere.center) * (contactOffset - offset);
+			break;
+		}
+		case Shape::Capsule:
+		{
+			const CapsuleCollider& capsule = capsules[collider.index];
+			const glm::vec3 axis = capsule.b - capsule.a;
+			const float axisLengthSquared = glm::dot(axis, axis);
+			const float t = axisLengthSquared > 0.f ? glm::clamp(glm::dot(position - capsule.a, axis) / axisLengthSquared, 0.f, 1.f) : 0.f;
+			const glm::vec3 closest = capsule.a + axis * t;
+			const float offset = glm::distance(closest, position) - capsule.radius;
+			if (offset < contactOffset)
+				position += glm::normalize(position - closest) * (contactOffset - offset);
+			break;
+		}
+		case Shape::Box:
+		{
+			const BoxCollider& box = boxes[collider.index];
+			const glm::vec3 relative = position - box.center;
+			glm::vec3 local(glm::dot(relative, box.orientation[0]), glm::dot(relative, box.orientation[1]), glm::dot(relative, box.orientation[2]));
+			const glm::vec3 closest = glm::clamp(local, -box.halfExtents, box.halfExtents);
+			const glm::vec3 outside = local - closest;
+			const float distanceSquared = glm::dot(outside, outside);
+			if (distanceSquared >= contactOffset * contactOffset)
+				break;
+
+			if (distanceSquared > 0.f)
+				local = closest + outside * (contactOffset / std::sqrt(distanceSquared));
+			else
+			{
+				// Inside: out through the nearest face
+				int face = 0;
+				float depth = box.halfExtents.x - std::abs(local.x);
+				for (int axis = 1; axis < 3; ++axis)
+				{
+					const float axisDepth = box.halfExtents[axis] - std::abs(local[axis]);
+					if (axisDepth < depth)
+					{
+						depth = axisDepth;
+						face = axis;
+					}
+				}
+				local[face] = (local[face] < 0.f ? -1.f : 1.f) * (box.halfExtents[face] + contactOffset);
+			}
+			position = box.center + box.orientation[0] * local.x + box.orientation[1] * local.y + box.orientation[2] * local.z;
+			break;
+		}
+		case Shape::Plane:
+		{
+			const PlaneCollider& plane = planes[collider.index];
+			const float offset = glm::dot(plane.normal, position) - plane.offset;
+			if (offset < contactOffset)
+				position += plane.normal * (contactOffset - offset);
+			break;
+		}
+		case Shape::DistanceField:
+		{
+			// The same push-out as for the analytic shapes, along the field gradient
+			const DistanceFieldCollider& distanceField = distanceFields[collider.index];
+			const glm::vec3 relative = position - distanceField.position;
+			const glm::vec3 local(glm::dot(relative, distanceField.orientation[0]), glm::dot(relative, distanceField.orientation[1]),
+				glm::dot(relative, distanceField.orientation[2]));
+			float offset;
+			glm::vec3 gradient;
+			if (!distanceField.field->sample(local, offset, gradient) || offset >= contactOffset)
+				break;
+
+			const float gradientLength = glm::length(gradient);
+			if (gradientLength > 0.f)
+				position += distanceField.orientation * (gradient * ((contactOffset - offset) / gradientLength));
+			break;
+		}
+		case Shape::TriangleMesh:
+		{
+			// The same push-out again, away from the closest triangle
+			const Mesh& mesh = meshes[collider.index];
+			float offset;
+			glm::vec3 direction;
+			if (mesh.bvh->closestPoint(mesh.pose, position, std::max(contactOffset, mesh.depth), offset, direction) && offset < contactOffset)
+				position += direction * (contactOffset - offset);
+			break;
+		}
+	}
+}
+
+void CollisionWorld::getSweepStarts(std::vector<glm::vec3>& starts) const
+{
+	starts.assign(colliders.size(), glm::vec3(std::numeric_limits<float>::quiet_NaN()));
+	for (uint32_t c = 0; c < colliders.size(); ++c)
+	{
+		if (colliders[c].shape == Shape::Sphere)
+			starts[c] = spheres[colliders[c].index].center;
+	}
+}
+
+void CollisionWorld::querySwept(const std::vector<glm::vec3>& sweepStarts, const glm::vec3& min, const glm::vec3& max, float margin,
+	std::vector<uint32_t>& result) const
+{
+	result.clear();
+	for (uint32_t c = 0; c < colliders.size(); ++c)
+	{
+		bool overlapping = overlaps(c, min, max, margin);
+		if (!overlapping && colliders[c].shape == Shape::Sphere && c < sweepStarts.size() && !std::isnan(sweepStarts[c].x))
+		{
+			// Bounds of the sweep, from the start to the end of the step
+			const float radius = spheres[colliders[c].index].radius;
+			const glm::vec3 boundsMin = glm::min(colliders[c].boundsMin, sweepStarts[c] - glm::vec3(radius));
+			const glm::vec3 boundsMax = glm::max(colliders[c].boundsMax, sweepStarts[c] + glm::vec3(radius));
+			overlapping = boundsMin.x <= max.x + margin && boundsMax.x >= min.x - margin && boundsMin.y <= max.y + margin &&
+				boundsMax.y >= min.y - margin && boundsMin.z <= max.z + margin && boundsMax.z >= min.z - margin;
+		}
+		if (overlapping)
+			result.push_back(c);
+	}
+}
+
+void CollisionWorld::resolveSwept(const std::vector<glm::vec3>& sweepStarts, const uint32_t* candidates, size_t count, float contactOffset,
+	const glm::vec3& start, glm::vec3& position) const
+{
+	for (size_t k = 0; k < count; ++k)
+	{
+		const uint32_t c = candidates[k];
+		const Collider& collider = colliders[c];
+		if (collider.shape == Shape::Sphere && c < sweepStarts.size() && !std::isnan(sweepStarts[c].x))
+		{
+			// The particle relative to the sphere moves from relativeStart by motion; the first time it is reach away
+			// from the center solves a quadratic, which only has a root ahead if it starts outside and approaches
+			const SphereCollider& sphere = spheres[collider.index];
+			const float reach = sphere.radius + contactOffset;
+			const glm::vec3 relativeStart = start - sweepStarts[c];
+			const glm::vec3 motion = position - sphere.center - relativeStart;
+			const float a = glm::dot(motion, motion);
+			const float b = glm::dot(relativeStart, motion);
+			const float outside = glm::dot(relativeStart, relativeStart) - reach * reach;
+			const float discriminant = b * b - a * outside;
+			if (outside > 0.f && b < 0.f && discriminant >= 0.f)
+			{
+				const float impact = (-b - std::sqrt(discriminant)) / a;
+				if (impact <= 1.f)
+				{
+					const glm::vec3 contact = relativeStart + motion * impact;
+					const glm::vec3 normal = contact / reach;
+					glm::vec3 remaining = motion * (1.f - impact);
+					remaining -= normal * std::min(glm::dot(remaining, normal), 0.f);
+					position = sphere.center + contact + remaining;
+				}
+			}
+		}
+
+		// Resting contact, and whatever the sweep left within the contact offset
+		resolve(collider, contactOffset, position);
+	}
+}
+
+bool CollisionWorld::hasChanged(uint32_t collider, const CollisionWorld& previous) const
+{
+	if (collider >= previous.colliders.size() || previous.colliders[collider].shape != colliders[collider].shape)
+		return true;
+
+	const uint32_t index = colliders[collider].index;
+	const uint32_t previousIndex = previous.colliders[collider].index;
+	switch (colliders[collider].shape)
+	{
+		case Shape::Sphere:
+			return spheres[index].center != previous.spheres[previousIndex].center || spheres[index].radius != previous.spheres[previousIndex].radius;
+		case Shape::Capsule:
+		{
+			const CapsuleCollider& capsule = capsules[index];
+			const CapsuleCollider& before = previous.capsules[previousIndex];
+			return capsule.a != before.a || capsule.b != before.b || capsule.radius != before.radius;
+		}
+		case Shape::Box:
+		{
+			const BoxCollider& box = boxes[index];
+			const BoxCollider& before = previous.boxes[previousIndex];
+			return box.center != before.center || box.halfExtents != before.halfExtents || box.orientation[0] != before.orientation[0] ||
+				box.orientation[1] != before.orientation[1] || box.orientation[2] != before.orientation[2];
+		}
+		case Shape::Plane:
+			return planes[index].normal != previous.planes[previousIndex].normal || planes[index].offset != previous.planes[previousIndex].offset;
+		case Shape::DistanceField:
+		{
+			const DistanceFieldCollider& distanceField = distanceFields[index];
+			const DistanceFieldCollider& before = previous.distanceFields[previousIndex];
+			return distanceField.field != before.field || distanceField.position != before.position || distanceField.orientation[0] != before.orientation[0] ||
+				distanceField.orientation[1] != before.orientation[1] || distanceField.orientation[2] != before.orientation[2];
+		}
+		case Shape::TriangleMesh:
+		{
+			const Mesh& mesh = meshes[index];
+			const Mesh& before = previous.meshes[previousIndex];
+			return mesh.bvh != before.bvh || mesh.depth != before.depth || mesh.pose.vertices != before.pose.vertices;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "Colliders.h"
+#include "SignedDistanceField.h"
+#include "TriangleMeshBvh.h"
+#include <glm/vec3.hpp>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Any number of primitive, distance field and triangle mesh colliders. The cloth queries it with the bounds of a block of particles
+// first and only pushes those particles out of the colliders whose bounds come within reach, so blocks far from every
+// collider never get to the narrow phase.
+class CollisionWorld {
+public:
+	void add(const SphereCollider& sphere);
+	void add(const CapsuleCollider& capsule);
+	void add(const BoxCollider& box);
+	void add(const PlaneCollider& plane);
+	void add(const DistanceFieldCollider& distanceField);
+	void add(const TriangleMeshCollider& mesh);
+	void clear();
+	size_t size() const { return colliders.size(); }
+	bool empty() const { return colliders.empty(); }
+
+	// Colliders that may come within margin of the box min .. max, as indices for resolve
+	void query(const glm::vec3& min, const glm::vec3& max, float margin, std::vector<uint32_t>& result) const;
+	bool overlaps(uint32_t collider, const glm::vec3& min, const glm::vec3& max, float margin) const;
+
+	// Pushes the position out of the given colliders, or of all of them, to at least contactOffset from their surfaces
+	void resolve(const uint32_t* candidates, size_t count, float contactOffset, glm::vec3& position) const;
+	void resolve(float contactOffset, glm::vec3& position) const;
+
+	// Sphere centers by collider index, NaN for the other colliders: where a later step sweeps the spheres from
+	void getSweepStarts(std::vector<glm::vec3>& starts) const;
+
+	// As query and resolve, with every sphere swept from its center in sweepStarts to where it is now and the particle
+	// from start to position. A particle the sphere runs into is put back onto it at the time of impact and slides
+	// along it for the rest of the step, so that a fast sphere cannot pass through in between. Colliders without a
+	// start are tested where they are.
+	void querySwept(const std::vector<glm::vec3>& sweepStarts, const glm::vec3& min, const glm::vec3& max, float margin, std::vector<uint32_t>& result) const;
+	void resolveSwept(const std::vector<glm::vec3>& sweepStarts, const uint32_t* candidates, size_t count, float contactOffset, const glm::vec3& start,
+		glm::vec3& position) const;
+
+	// Whether the collider differs from the one at the same index of an earlier state of the world
+	bool hasChanged(uint32_t collider, const CollisionWorld& previous) const;
+
+private:
+	enum class Shape : uint8_t {
+		Sphere,
+		Capsule,
+		Box,
+		Plane,
+		DistanceField,
+		TriangleMesh
+	};
+
+	// Shape and index into its list; planes have no bounds and are tested against the query box directly
+	struct Collider {
+		Shape shape;
+		uint32_t index;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	// A mesh with its hierarchy refit to the pose it was added in
+	struct Mesh {
+		std::shared_ptr<const TriangleMeshBvh> bvh;
+		TriangleMeshBvh::Pose pose;
+		float depth;
+	};
+
+	void resolve(const Collider& collider, float contactOffset, glm::vec3& position) const;
+
+	std::vector<Collider> colliders;
+	std::vector<SphereCollider> spheres;
+	std::vector<CapsuleCollider> capsules;
+	std::vector<BoxCollider> boxes;
+	std::vector<PlaneCollider> planes;
+	std::vector<DistanceFieldCollider> distanceFields;
+	std::vector<Mesh> meshes;
+};
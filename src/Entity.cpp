@@ -1,8 +1,6 @@
 #include "Entity.h"
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/quaternion.hpp>
 
-Entity::Entity() : rotationQuat(glm::angleAxis(0.f, glm::vec3(1.f, 0.f, 0.f)))
+Entity::Entity()
 {
 	glGenBuffers(1, &vbo);
 	glGenVertexArrays(1, &vao);
@@ -14,24 +12,6 @@ Entity::~Entity()
 	glDeleteVertexArrays(1, &vao);
 }
 
-void Entity::rotate(float angle, const glm::vec3& axis)
-{
-	rotationQuat = glm::angleAxis(glm::radians(angle), axis);
-	transformMatrix = glm::scale(glm::translate(glm::mat4(1.f), translationVector) * glm::mat4_cast(rotationQuat), scaleVector);
-}
-
-void Entity::scale(const glm::vec3& scale)
-{
-	scaleVector = scale;
-	transformMatrix = glm::scale(glm::translate(glm::mat4(1.f), translationVector) * glm::mat4_cast(rotationQuat), scaleVector);
-}
-
-void Entity::translate(const glm::vec3& translation)
-{
-	translationVector = translation;
-	transformMatrix = glm::scale(glm::translate(glm::mat4(1.f), translationVector) * glm::mat4_cast(rotationQuat), scaleVector);
-}
-
 void Entity::updateColorsBasedOnMaterial(const Shader& shader, Material material) const
 {
 	switch (material) 
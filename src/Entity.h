@@ -1,21 +1,13 @@
 #pragma once
 #include <glad/glad.h>
-#include <glm/mat4x4.hpp>
-#include <glm/vec3.hpp>
-#include <glm/ext/quaternion_float.hpp>
+#include "Transformable.h"
 #include "Shader.h"
 
-class Entity {
+class Entity : public Transformable {
 public:
 	Entity();
-	virtual ~Entity();
+	~Entity() override;
 	virtual void draw() const = 0;
-	void rotate(float angle, const glm::vec3& axis);
-	void scale(const glm::vec3& factor);
-	void translate(const glm::vec3& factor);
-	const glm::mat4& getTransformMatrix() { return transformMatrix; }
-	const glm::vec3& getScale() const { return scaleVector; }
-	const glm::vec3& getTranslation() const { return translationVector; }
 	glm::vec3 color{ 1.f };
 
 	enum class Material {
@@ -27,10 +19,6 @@ public:
 	void updateColorsBasedOnMaterial(const Shader& shader, Material material) const;
 
 protected:
-	glm::mat4 transformMatrix{ 1.f };
-	glm::quat rotationQuat;
-	glm::vec3 translationVector{ 0.f };
-	glm::vec3 scaleVector{ 1.f };
 	GLuint vbo = 0;
 	GLuint vao = 0;
 	GLuint verticesCount = 0;
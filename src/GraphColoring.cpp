@@ -0,0 +1,57 @@
+#include "GraphColoring.h"
+#include <algorithm>
+
+static Coloring groupByColor(const std::vector<uint32_t>& colors, uint32_t colorCount)
+{
+	Coloring coloring;
+	coloring.colorOffsets.assign(colorCount + 1, 0);
+	for (uint32_t color : colors)
+		++coloring.colorOffsets[color + 1];
+
+	for (uint32_t c = 0; c < colorCount; ++c)
+		coloring.colorOffsets[c + 1] += coloring.colorOffsets[c];
+
+	std::vector<uint32_t> fill(coloring.colorOffsets.begin(), coloring.colorOffsets.end() - 1);
+	coloring.order.resize(colors.size());
+	for (size_t i = 0; i < colors.size(); ++i)
+		coloring.order[fill[colors[i]]++] = (uint32_t)i;
+
+	return coloring;
+}
+
+Coloring colorSprings(const Springs& springs, const std::vector<uint32_t>& adjacencyOffsets, const std::vector<uint32_t>& adjacency)
+{
+	constexpr uint32_t uncolored = ~0u;
+	std::vector<uint32_t> colors(springs.size(), uncolored);
+	std::vector<bool> used;
+	uint32_t colorCount = 0;
+	for (size_t s = 0; s < springs.size(); ++s)
+	{
+		used.assign(colorCount + 1, false);
+		for (uint32_t particle : { springs.particle1[s], springs.particle2[s] })
+		{
+			for (uint32_t a = adjacencyOffsets[particle]; a < adjacencyOffsets[particle + 1]; ++a)
+			{
+				const uint32_t neighbourColor = colors[adjacency[a] >> 1];
+				if (neighbourColor != uncolored)
+					used[neighbourColor] = true;
+			}
+		}
+
+		colors[s] = (uint32_t)(std::find(used.begin(), used.end(), false) - used.begin());
+		colorCount = std::max(colorCount, colors[s] + 1);
+	}
+
+	return groupByColor(colors, colorCount);
+}
+
+Coloring colorGrid(size_t width, size_t height, size_t reach)
+{
+	const size_t period = reach + 1;
+	std::vector<uint32_t> colors(width * height);
+	for (size_t row = 0; row < height; ++row)
+		for (size_t column = 0; column < width; ++column)
+			colors[row * width + column] = (uint32_t)((row % period) * period + column % period);
+
+	return groupByColor(colors, (uint32_t)(period * period));
+}
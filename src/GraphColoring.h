@@ -0,0 +1,19 @@
+#pragma once
+#include "Springs.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Items grouped into colors: items colorOffsets[c] .. colorOffsets[c + 1] of order belong to color c
+struct Coloring {
+	size_t getColorCount() const { return colorOffsets.empty() ? 0 : colorOffsets.size() - 1; }
+	std::vector<uint32_t> colorOffsets;
+	std::vector<uint32_t> order;
+};
+
+// Greedy edge coloring: no two springs of the same color share a particle, so a color can be processed in parallel
+Coloring colorSprings(const Springs& springs, const std::vector<uint32_t>& adjacencyOffsets, const std::vector<uint32_t>& adjacency);
+
+// Vertex coloring of a row-major width x height grid whose edges reach at most `reach` rows and columns:
+// colors repeat every reach + 1 vertices in both directions, so adjacent vertices never share a color
+Coloring colorGrid(size_t width, size_t height, size_t reach);
@@ -0,0 +1,239 @@
+#include "GraphOrdering.h"
+#include <algorithm>
+#include <glm/glm.hpp>
+
+namespace {
+	class NestedDissection {
+	public:
+		NestedDissection(const Graph& _graph) : graph(_graph), region(graph.getVertexCount(), 0), level(graph.getVertexCount(), -1) {}
+
+		std::vector<uint32_t> run()
+		{
+			std::vector<uint32_t> vertices(graph.getVertexCount());
+			for (size_t v = 0; v < vertices.size(); ++v)
+				vertices[v] = (uint32_t)v;
+			dissect(vertices, 0);
+			return std::move(order);
+		}
+
+	private:
+		// Breadth-first search inside the region, returns the visited vertices in visiting order
+		void breadthFirstSearch(uint32_t start, uint32_t regionId, std::vector<uint32_t>& visited)
+		{
+			for (uint32_t v : visited) level[v] = -1;
+			visited.assign(1, start);
+			level[start] = 0;
+			for (size_t head = 0; head < visited.size(); ++head)
+			{
+				const uint32_t v = visited[head];
+				for (uint32_t n = graph.offsets[v]; n < graph.offsets[v + 1]; ++n)
+				{
+					const uint32_t neighbour = graph.neighbours[n];
+					if (region[neighbour] == regionId && level[neighbour] < 0)
+					{
+						level[neighbour] = level[v] + 1;
+						visited.push_back(neighbour);
+					}
+				}
+			}
+		}
+
+		void dissect(std::vector<uint32_t>& vertices, uint32_t regionId)
+		{
+			constexpr size_t leafSize = 32;
+			if (vertices.size() <= leafSize)
+			{
+				order.insert(order.end(), vertices.begin(), vertices.end());
+				return;
+			}
+
+			// Two sweeps find a pseudo-peripheral start vertex, which gives long and thin level sets
+			std::vector<uint32_t> visited;
+			breadthFirstSearch(vertices.front(), regionId, visited);
+			breadthFirstSearch(visited.back(), regionId, visited);
+
+			// Vertices the search did not reach form separate components and are dissected on their own
+			if (visited.size() < vertices.size())
+			{
+				const uint32_t reachedRegion = ++regionCount;
+				for (uint32_t v : visited)
+				{
+					region[v] = reachedRegion;
+					level[v] = -1;
+				}
+
+				std::vector<uint32_t> rest;
+				const uint32_t restRegion = ++regionCount;
+				for (uint32_t v : vertices)
+				{
+					if (region[v] != regionId) continue;
+					rest.push_back(v);
+					region[v] = restRegion;
+				}
+
+				dissect(visited, reachedRegion);
+				dissect(rest, restRegion);
+				return;
+			}
+
+			const int separatorLevel = level[visited[visited.size() / 2]];
+			const int lastLevel = level[visited.back()];
+			if (separatorLevel == 0 || separatorLevel == lastLevel)
+			{
+				for (uint32_t v : visited) level[v] = -1;
+				order.insert(order.end(), vertices.begin(), vertices.end());
+				return;
+			}
+
+			// Edges only join equal or adjacent levels, so the middle level separates the ones below from the ones above
+			std::vector<uint32_t> lower, upper, separator;
+			const uint32_t lowerRegion = ++regionCount;
+			const uint32_t upperRegion = ++regionCount;
+			for (uint32_t v : visited)
+			{
+				if (level[v] < separatorLevel)
+				{
+					lower.push_back(v);
+					region[v] = lowerRegion;
+				}
+				else if (level[v] > separatorLevel)
+				{
+					upper.push_back(v);
+					region[v] = upperRegion;
+				}
+				else
+				{
+					separator.push_back(v);
+					region[v] = ~0u;
+				}
+
+				level[v] = -1;
+			}
+
+			vertices.clear();
+			vertices.shrink_to_fit();
+			dissect(lower, lowerRegion);
+			dissect(upper, upperRegion);
+			order.insert(order.end(), separator.begin(), separator.end());
+		}
+
+		const Graph& graph;
+		std::vector<uint32_t> region;
+		std::vector<int> level;
+		std::vector<uint32_t> order;
+		uint32_t regionCount = 0;
+	};
+}
+
+std::vector<uint32_t> computeNestedDissectionOrdering(const Graph& graph)
+{
+	return NestedDissection(graph).run();
+}
+
+// Breadth-first search over the unvisited vertices, appending them to order. Neighbours are taken by increasing
+// degree. Returns the index in order where the last level starts.
+static size_t cuthillMcKeeSearch(const Graph& graph, uint32_t start, std::vector<bool>& visited, std::vector<uint32_t>& order)
+{
+	auto degree = [&](uint32_t v) { return graph.offsets[v + 1] - graph.offsets[v]; };
+	const size_t begin = order.size();
+	size_t levelBegin = begin;
+	size_t levelEnd = begin + 1;
+	visited[start] = true;
+	order.push_back(start);
+	std::vector<uint32_t> candidates;
+	for (size_t head = begin; head < order.size(); ++head)
+	{
+		if (head == levelEnd)
+		{
+			levelBegin = levelEnd;
+			levelEnd = order.size();
+		}
+
+		const uint32_t v = order[head];
+		candidates.clear();
+		for (uint32_t n = graph.offsets[v]; n < graph.offsets[v + 1]; ++n)
+		{
+			const uint32_t neighbour = graph.neighbours[n];
+			if (!visited[neighbour])
+			{
+				visited[neighbour] = true;
+				candidates.push_back(neighbour);
+			}
+		}
+
+		std::stable_sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) { return degree(a) < degree(b); });
+		order.insert(order.end(), candidates.begin(), candidates.end());
+	}
+
+	return levelBegin;
+}
+
+std::vector<uint32_t> computeReverseCuthillMcKeeOrdering(const Graph& graph)
+{
+	const size_t vertexCount = graph.getVertexCount();
+	auto degree = [&](uint32_t v) { return graph.offsets[v + 1] - graph.offsets[v]; };
+	std::vector<bool> visited(vertexCount, false);
+	std::vector<bool> probeVisited;
+	std::vector<uint32_t> order, probe;
+	order.reserve(vertexCount);
+	for (uint32_t seed = 0; seed < vertexCount; ++seed)
+	{
+		if (visited[seed]) continue;
+
+		// Pseudo-peripheral start: repeatedly jump to the lowest degree vertex of the deepest level
+		uint32_t start = seed;
+		for (int sweep = 0; sweep < 2; ++sweep)
+		{
+			probeVisited = visited;
+			probe.clear();
+			const size_t lastLevel = cuthillMcKeeSearch(graph, start, probeVisited, probe);
+			start = *std::min_element(probe.begin() + lastLevel, probe.end(), [&](uint32_t a, uint32_t b) { return degree(a) < degree(b); });
+		}
+
+		cuthillMcKeeSearch(graph, start, visited, order);
+	}
+
+	std::reverse(order.begin(), order.end());
+	return order;
+}
+
+// Spreads the low 21 bits of value so two zero bits follow every bit
+static uint64_t spreadBits(uint64_t value)
+{
+	value &= 0x1fffff;
+	value = (value | value << 32) & 0x1f00000000ffffull;
+	value = (value | value << 16) & 0x1f0000ff0000ffull;
+	value = (value | value << 8) & 0x100f00f00f00f00full;
+	value = (value | value << 4) & 0x10c30c30c30c30c3ull;
+	value = (value | value << 2) & 0x1249249249249249ull;
+	return value;
+}
+
+std::vector<uint32_t> computeMortonOrdering(const std::vector<glm::vec3>& points)
+{
+	glm::vec3 lower(0.f), upper(0.f);
+	if (!points.empty())
+		lower = upper = points[0];
+	for (const glm::vec3& point : points)
+	{
+		lower = glm::min(lower, point);
+		upper = glm::max(upper, point);
+	}
+
+	const float cells = (float)((1 << 21) - 1);
+	const glm::vec3 extent = upper - lower;
+	std::vector<uint64_t> codes(points.size());
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		uint64_t cell[3];
+		for (int axis = 0; axis < 3; ++axis)
+			cell[axis] = extent[axis] > 0.f ? (uint64_t)((points[i][axis] - lower[axis]) / extent[axis] * cells) : 0;
+		codes[i] = spreadBits(cell[0]) | spreadBits(cell[1]) << 1 | spreadBits(cell[2]) << 2;
+	}
+
+	std::vector<uint32_t> order(points.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = (uint32_t)i;
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return codes[a] < codes[b]; });
+	return order;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <glm/vec3.hpp>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Undirected graph in compressed sparse row form: the neighbours of vertex v are
+// neighbours[offsets[v]] .. neighbours[offsets[v + 1]]
+struct Graph {
+	size_t getVertexCount() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> neighbours;
+};
+
+// Fill-reducing elimination order from recursive breadth-first level-set separators.
+// Entry k of the result is the vertex eliminated k-th.
+std::vector<uint32_t> computeNestedDissectionOrdering(const Graph& graph);
+
+// Bandwidth-reducing order: Cuthill-McKee breadth-first search from a pseudo-peripheral vertex of every
+// component, visiting neighbours by increasing degree, reversed at the end
+std::vector<uint32_t> computeReverseCuthillMcKeeOrdering(const Graph& graph);
+
+// Z-order curve through the points, with coordinates quantized to 21 bits per axis inside their bounding box
+std::vector<uint32_t> computeMortonOrdering(const std::vector<glm::vec3>& points);
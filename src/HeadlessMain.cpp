@@ -0,0 +1,378 @@
+#include "Cloth.h"
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+static void printUsage()
+{
+	std::cout << "Usage: cloth_headless [options]" << std::endl
+		<< "  --frames <count>            number of steps to simulate (default 600)" << std::endl
+		<< "  --size <width> <height>     particle grid size (default 50 30)" << std::endl
+		<< "  --dt <seconds>              timestep (default 1/240)" << std::endl
+		<< "  --threads <count>           worker threads (default: hardware concurrency)" << std::endl
+		<< "  --solver <name>             explicit | implicit | xpbd | pd | vbd | multigrid (default explicit)" << std::endl
+		<< "  --substeps <count>          substeps per frame (default 1)" << std::endl
+		<< "  --multirate <count>         explicit fine steps per substep for the stiff springs (default 0, off)" << std::endl
+		<< "  --sleep                     let resting tiles of the cloth sleep (explicit solver)" << std::endl
+		<< "  --no-wind                   disable the wind force" << std::endl
+		<< "  --sdf <cache file>          collide with a distance field of a sphere mesh instead of the analytic sphere" << std::endl
+		<< "  --mesh                      collide with a deforming sphere mesh instead, refit every frame" << std::endl
+		<< "  --launch <speed>            the sphere rises into the cloth from below at this speed and stops above it" << std::endl
+		<< "  --ccd                       sweep moving spheres against the particle trajectories" << std::endl
+		<< "  --self-collision            keep particles that no spring connects apart" << std::endl
+		<< "  --props <count>             add a ground plane and this many capsules, boxes and spheres around the cloth" << std::endl
+		<< "  --tethers <stretch>         keep particles within their geodesic distance to the nearest pin, plus this fraction" << std::endl
+		<< "  --adaptive                  adaptive substepping with divergence rollback" << std::endl
+		<< "  --temporal-blocking <count> explicit substeps per cache-resident tile (default 0, off)" << std::endl
+		<< "  --subspace <modes>          train a reduced model over the same frames with --solver, then run it (default 0, off)" << std::endl
+		<< "  --cubature <count>          springs and particles the reduced model samples its forces at (default 120)" << std::endl
+		<< "  --iterations <count>        solver iterations per substep (xpbd, pd, vbd, multigrid; default per solver)" << std::endl
+		<< "  --force-kernel <name>       stencil | springs, spring force pass of the explicit and implicit solvers (default stencil)" << std::endl
+		<< "  --ordering <name>           rowmajor | morton | rcm, particle memory order (default rowmajor)" << std::endl
+		<< "  --verify-kernels            check the SIMD spring kernels against the scalar reference" << std::endl;
+}
+
+static bool parseOrdering(const std::string& name, Cloth::ParticleOrdering& ordering)
+{
+	if (name == "rowmajor") ordering = Cloth::ParticleOrdering::RowMajor;
+	else if (name == "morton") ordering = Cloth::ParticleOrdering::Morton;
+	else if (name == "rcm") ordering = Cloth::ParticleOrdering::ReverseCuthillMcKee;
+	else return false;
+	return true;
+}
+
+static bool parseSolver(const std::string& name, Cloth::Solver& solver)
+{
+	if (name == "explicit") solver = Cloth::Solver::Explicit;
+	else if (name == "implicit") solver = Cloth::Solver::Implicit;
+	else if (name == "xpbd") solver = Cloth::Solver::XPBD;
+	else if (name == "pd") solver = Cloth::Solver::ProjectiveDynamics;
+	else if (name == "vbd") solver = Cloth::Solver::VBD;
+	else if (name == "multigrid") solver = Cloth::Solver::Multigrid;
+	else return false;
+	return true;
+}
+
+// Props standing on a ground plane in a ring around the sphere, the cloth drapes over the inner ones
+static void addProps(CollisionWorld& colliders, size_t count)
+{
+	if (count == 0) return;
+
+	PlaneCollider ground;
+	ground.offset = -8.f;
+	colliders.add(ground);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float angle = 2.f * glm::pi<float>() * i / count;
+		const float distance = 4.f + 6.f * (i % 3);
+		const glm::vec3 base(distance * std::cos(angle), ground.offset, distance * std::sin(angle));
+		if (i % 3 == 0)
+		{
+			CapsuleCollider capsule;
+			capsule.a = base;
+			capsule.b = base + glm::vec3(0.f, 3.f, 0.f);
+			capsule.radius = 0.5f;
+			colliders.add(capsule);
+		}
+		else if (i % 3 == 1)
+		{
+			BoxCollider box;
+			box.halfExtents = glm::vec3(1.f, 0.75f, 0.5f);
+			box.center = base + glm::vec3(0.f, box.halfExtents.y, 0.f);
+			box.orientation = glm::mat3(glm::vec3(std::cos(angle), 0.f, std::sin(angle)), glm::vec3(0.f, 1.f, 0.f), glm::vec3(-std::sin(angle), 0.f, std::cos(angle)));
+			colliders.add(box);
+		}
+		else
+		{
+			SphereCollider sphere;
+			sphere.radius = 1.f;
+			sphere.center = base + glm::vec3(0.f, sphere.radius, 0.f);
+			colliders.add(sphere);
+		}
+	}
+}
+
+// Subdivided icosahedron, projected onto the sphere, wound counterclockwise seen from outside
+static void createSphereMesh(float radius, unsigned subdivisions, std::vector<glm::vec3>& vertices, std::vector<uint32_t>& indices)
+{
+	const float t = (1.f + std::sqrt(5.f)) / 2.f;
+	vertices = { { -1.f, t, 0.f }, { 1.f, t, 0.f }, { -1.f, -t, 0.f }, { 1.f, -t, 0.f }, { 0.f, -1.f, t }, { 0.f, 1.f, t },
+		{ 0.f, -1.f, -t }, { 0.f, 1.f, -t }, { t, 0.f, -1.f }, { t, 0.f, 1.f }, { -t, 0.f, -1.f }, { -t, 0.f, 1.f } };
+	indices = { 0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11, 1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+		3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9, 4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1 };
+	for (unsigned level = 0; level < subdivisions; ++level)
+	{
+		std::map<std::pair<uint32_t, uint32_t>, uint32_t> midpoints;
+		auto midpoint = [&](uint32_t a, uint32_t b) {
+			const std::pair<uint32_t, uint32_t> key(std::min(a, b), std::max(a, b));
+			auto found = midpoints.find(key);
+			if (found != midpoints.end())
+				return found->second;
+			vertices.push_back((vertices[a] + vertices[b]) * 0.5f);
+			return midpoints[key] = (uint32_t)vertices.size() - 1;
+		};
+
+		std::vector<uint32_t> subdivided;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			const uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+			const uint32_t ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+			subdivided.insert(subdivided.end(), { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca });
+		}
+		indices.swap(subdivided);
+	}
+
+	for (glm::vec3& vertex : vertices)
+		vertex = glm::normalize(vertex) * radius;
+}
+
+// Ripples travelling up the sphere mesh, as a stand-in for an animated character
+static void deformSphereMesh(const std::vector<glm::vec3>& restVertices, const glm::vec3& center, float radius, float time, std::vector<glm::vec3>& vertices)
+{
+	vertices.resize(restVertices.size());
+	for (size_t i = 0; i < restVertices.size(); ++i)
+		vertices[i] = center + restVertices[i] * (1.f + 0.1f * std::sin(3.f * restVertices[i].y / radius - 2.f * time));
+}
+
+static int verifyKernels()
+{
+	// Every vectorized spring kernel has to match the scalar reference
+	bool passed = true;
+	for (int level = (int)SimdLevel::Scalar; level <= (int)getSupportedSimdLevel(); ++level)
+	{
+		const float error = verifySpringForceKernel((SimdLevel)level, 100003);
+		passed = passed && error < 1e-4f;
+		std::cout << getSimdLevelName((SimdLevel)level) << ": max relative error " << error << std::endl;
+	}
+
+	return passed ? 0 : 1;
+}
+
+// Steps the same scene as the viewer without creating a window or GL context.
+int main(int argc, char** argv)
+{
+	size_t frameCount = 600;
+	size_t horizontalCount = 50;
+	size_t verticalCount = 30;
+	float timeStep = 1.f / 240.f;
+	unsigned threadCount = std::thread::hardware_concurrency();
+	Cloth::Solver solver = Cloth::Solver::Explicit;
+	unsigned substepCount = 1;
+	unsigned substepsPerTile = 0;
+	bool adaptive = false;
+	unsigned multirateSteps = 0;
+	bool sleeping = false;
+	bool wind = true;
+	float tetherStretch = -1.f;
+	size_t propCount = 0;
+	std::string distanceFieldCache;
+	bool deformingMesh = false;
+	float launchSpeed = 0.f;
+	bool continuousCollision = false;
+	bool selfCollision = false;
+	unsigned iterationCount = 0;
+	size_t modeCount = 0;
+	size_t cubatureSize = 120;
+	Cloth::ForceKernel forceKernel = Cloth::ForceKernel::Stencil;
+	Cloth::ParticleOrdering ordering = Cloth::ParticleOrdering::RowMajor;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string option = argv[i];
+		const int remaining = argc - i - 1;
+		if (option == "--verify-kernels") return verifyKernels();
+		else if (option == "--frames" && remaining >= 1) frameCount = std::strtoul(argv[++i], nullptr, 10);
+		else if (option == "--size" && remaining >= 2)
+		{
+			horizontalCount = std::strtoul(argv[++i], nullptr, 10);
+			verticalCount = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (option == "--dt" && remaining >= 1) timeStep = std::strtof(argv[++i], nullptr);
+		else if (option == "--threads" && remaining >= 1) threadCount = (unsigned)std::strtoul(argv[++i], nullptr, 10);
+		else if (option == "--solver" && remaining >= 1 && parseSolver(argv[i + 1], solver)) ++i;
+		else if (option == "--ordering" && remaining >= 1 && parseOrdering(argv[i + 1], ordering)) ++i;
+		else if (option == "--substeps" && remaining >= 1) substepCount = (unsigned)std::strtoul(argv[++i], nullptr, 10);
+		else if (option == "--adaptive") adaptive = true;
+		else if (option == "--sleep") sleeping = true;
+		else if (option == "--no-wind") wind = false;
+		else if (option == "--sdf" && remaining >= 1) distanceFieldCache = argv[++i];
+		else if (option == "--mesh") deformingMesh = true;
+		else if (option == "--launch" && remaining >= 1) launchSpeed = std::strtof(argv[++i], nullptr);
+		else if (option == "--ccd") continuousCollision = true;
+		else if (option == "--self-collision") selfCollision = true;
+		else if (option == "--props" && remaining >= 1) propCount = std::strtoul(argv[++i], nullptr, 10);
+		else if (option == "--tethers" && remaining >= 1) tetherStretch = std::strtof(argv[++i], nullptr);
+		else if (option == "--multirate" && remaining >= 1) multirateSteps = (unsigned)std::strtoul(argv[++i], nullptr, 10);
+		else if (option == "--temporal-blocking" && remaining >= 1) substepsPerTile = (unsigned)std::strtoul(argv[++i], nullptr, 10);
+		else if (option == "--subspace" && remaining >= 1) modeCount = std::strtoul(argv[++i], nullptr, 10);
+		else if (option == "--cubature" && remaining >= 1) cubatureSize = std::strtoul(argv[++i], nullptr, 10);
+		else if (option == "--iterations" && remaining >= 1) iterationCount = (unsigned)std::strtoul(argv[++i], nullptr, 10);
+		else if (option == "--force-kernel" && remaining >= 1 && (argv[i + 1] == std::string("stencil") || argv[i + 1] == std::string("springs")))
+			forceKernel = argv[++i] == std::string("stencil") ? Cloth::ForceKernel::Stencil : Cloth::ForceKernel::SpringList;
+		else
+		{
+			printUsage();
+			return option == "--help" ? 0 : 1;
+		}
+	}
+
+	CollisionWorld colliders;
+	SphereCollider sphere;
+	sphere.center = glm::vec3(0.f, launchSpeed > 0.f ? -12.f : -4.f, 0.f);
+	sphere.radius = 2.f;
+	const glm::vec3 sphereStart = sphere.center;
+	const float launchHeight = 11.f;
+	std::shared_ptr<SignedDistanceField> distanceField;
+	bool distanceFieldCached = false;
+	double distanceFieldTime = 0.0;
+	std::vector<glm::vec3> meshRestVertices;
+	TriangleMeshCollider mesh;
+	double refitTime = 0.0;
+	if (deformingMesh)
+	{
+		std::vector<uint32_t> indices;
+		createSphereMesh(sphere.radius, 5, meshRestVertices, indices);
+		std::shared_ptr<TriangleMeshBvh> bvh = std::make_shared<TriangleMeshBvh>();
+		bvh->build(meshRestVertices, indices);
+		mesh.bvh = bvh;
+	}
+	else if (!distanceFieldCache.empty())
+	{
+		std::vector<glm::vec3> vertices;
+		std::vector<uint32_t> indices;
+		createSphereMesh(sphere.radius, 4, vertices, indices);
+		const auto buildStart = std::chrono::steady_clock::now();
+		distanceField = std::make_shared<SignedDistanceField>();
+		distanceFieldCached = distanceField->loadOrBuild(vertices, indices, 0.05f, 0.25f, distanceFieldCache);
+		distanceFieldTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+	}
+
+	// The sphere, as whichever collider was asked for, at the given time
+	auto addColliders = [&](float time) {
+		sphere.center = sphereStart + glm::vec3(0.f, std::min(launchSpeed * time, launchHeight), 0.f);
+		if (mesh.bvh)
+		{
+			deformSphereMesh(meshRestVertices, sphere.center, sphere.radius, time, mesh.vertices);
+			colliders.add(mesh);
+		}
+		else if (distanceField)
+		{
+			DistanceFieldCollider collider;
+			collider.field = distanceField;
+			collider.position = sphere.center;
+			colliders.add(collider);
+		}
+		else
+			colliders.add(sphere);
+		addProps(colliders, propCount);
+	};
+	addColliders(0.f);
+
+	std::shared_ptr<ThreadPool> pool = std::make_shared<ThreadPool>(threadCount);
+	auto createCloth = [&]() {
+		std::unique_ptr<Cloth> cloth(new Cloth(horizontalCount, verticalCount));
+		cloth->scale(glm::vec3(10.f, 10.f, 1.f));
+		cloth->rotate(-90.f, glm::vec3(1.f, 0.f, 0.f));
+		cloth->setThreadPool(pool);
+		cloth->setParticleOrdering(ordering);
+		cloth->setSolver(solver);
+		cloth->setSubstepCount(substepCount);
+		cloth->setTemporalBlocking(substepsPerTile);
+		cloth->setAdaptiveTimeStep(adaptive);
+		cloth->setMultirateSteps(multirateSteps);
+		cloth->setSleeping(sleeping);
+		cloth->setWind(wind);
+		cloth->setTethers(tetherStretch >= 0.f);
+		cloth->setTetherStretch(std::max(tetherStretch, 0.f));
+		cloth->setForceKernel(forceKernel);
+		cloth->setContinuousCollision(continuousCollision);
+		cloth->setSelfCollision(selfCollision);
+		if (iterationCount > 0)
+		{
+			cloth->getXPBDSolver().setIterations(iterationCount);
+			cloth->getProjectiveDynamicsSolver().setIterations(iterationCount);
+			cloth->getVBDSolver().setIterations(iterationCount);
+			cloth->getMultigridSolver().setIterations(iterationCount);
+		}
+		return cloth;
+	};
+
+	Time t;
+	t.deltaTime = timeStep;
+	t.lastDeltaTime = t.deltaTime;
+	t.frameRate = 1.f / t.deltaTime;
+
+	// The reduced model is trained on a full simulation of the same frames and then replaces it
+	std::unique_ptr<Cloth> cloth = createCloth();
+	std::shared_ptr<SubspaceModel> subspace;
+	double trainingTime = 0.0;
+	if (modeCount > 0)
+	{
+		const auto trainingStart = std::chrono::steady_clock::now();
+		subspace = createCloth()->trainSubspace(t, colliders, frameCount, modeCount, cubatureSize);
+		trainingTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - trainingStart).count();
+		cloth->setSubspaceModel(subspace);
+		cloth->setSolver(Cloth::Solver::Subspace);
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t frame = 0; frame < frameCount; ++frame)
+	{
+		if (deformingMesh || launchSpeed > 0.f)
+		{
+			// The world is rebuilt every frame, as the viewer does, which also refits the mesh to its new pose
+			const auto refitStart = std::chrono::steady_clock::now();
+			colliders.clear();
+			addColliders(t.runningTime);
+			refitTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - refitStart).count();
+		}
+		cloth->updatePhysics(t, colliders);
+		t.runningTime += t.deltaTime;
+	}
+	const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::vector<glm::vec3> translations;
+	cloth->getTranslations(translations);
+	glm::vec3 checksum(0.f);
+	for (const glm::vec3& translation : translations)
+		checksum += translation;
+
+	std::cout << "Particles: " << cloth->getParticleCount() << std::endl;
+	std::cout << "Threads: " << threadCount << std::endl;
+	if (forceKernel == Cloth::ForceKernel::Stencil)
+		std::cout << "Spring kernel: grid stencil" << std::endl;
+	else
+		std::cout << "Spring kernel: " << getSimdLevelName(cloth->getSimdLevel()) << std::endl;
+	std::cout << "Frames: " << frameCount << std::endl;
+	if (adaptive)
+		std::cout << "Substeps (last frame): " << cloth->getLastSubstepCount() << ", rollbacks: " << cloth->getRollbackCount() << std::endl;
+	if (distanceField)
+	{
+		std::cout << "Distance field: " << distanceField->getBrickCount() << " bricks, " << (distanceFieldCached ? "loaded" : "built") << " in "
+			<< distanceFieldTime << " ms" << std::endl;
+	}
+	if (deformingMesh)
+	{
+		std::cout << "Triangle mesh: " << mesh.bvh->getTriangleCount() << " triangles, " << mesh.bvh->getNodeCount() << " nodes, refit "
+			<< (frameCount ? refitTime / frameCount : 0.0) << " ms per frame" << std::endl;
+	}
+	if (subspace)
+	{
+		std::cout << "Subspace: " << subspace->getModeCount() << " modes, " << subspace->getCubatureSize() << " cubature elements, cubature error "
+			<< subspace->getCubatureError() << ", training " << trainingTime << " ms" << std::endl;
+	}
+	if (cloth->getSolverFailureCount() > 0)
+		std::cout << "Solver failures: " << cloth->getSolverFailureCount() << std::endl;
+	if (selfCollision)
+		std::cout << "Self contacts (last substep): " << cloth->getSelfContactCount() << std::endl;
+	if (sleeping)
+		std::cout << "Awake tiles: " << cloth->getAwakeTileCount() << " of " << cloth->getTileCount() << std::endl;
+	std::cout << "Total: " << elapsed.count() << " ms, per frame: " << (frameCount ? elapsed.count() / frameCount : 0.0) << " ms" << std::endl;
+	std::cout << "Translation sum: " << checksum.x << " " << checksum.y << " " << checksum.z << std::endl;
+}
@@ -0,0 +1,179 @@
+#include "ImplicitSolver.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+
+void ImplicitSolver::initialize(const Particles& particles, const Springs& springs, const std::vector<uint32_t>& _adjacencyOffsets, const std::vector<uint32_t>& _adjacency)
+{
+	adjacencyOffsets = &_adjacencyOffsets;
+	adjacency = &_adjacency;
+	const size_t particleCount = particles.size();
+	blockRowOffsets.assign(particleCount + 1, 0);
+	blockColumns.clear();
+	diagonalBlocks.resize(particleCount);
+	adjacencyBlocks.resize(adjacency->size());
+
+	std::vector<uint32_t> rowColumns;
+	for (size_t i = 0; i < particleCount; ++i)
+	{
+		rowColumns.assign(1, (uint32_t)i);
+		for (uint32_t a = (*adjacencyOffsets)[i]; a < (*adjacencyOffsets)[i + 1]; ++a)
+		{
+			const uint32_t s = (*adjacency)[a] >> 1;
+			rowColumns.push_back(((*adjacency)[a] & 1) ? springs.particle1[s] : springs.particle2[s]);
+		}
+
+		std::sort(rowColumns.begin(), rowColumns.end());
+		rowColumns.erase(std::unique(rowColumns.begin(), rowColumns.end()), rowColumns.end());
+		const uint32_t rowBegin = (uint32_t)blockColumns.size();
+		blockColumns.insert(blockColumns.end(), rowColumns.begin(), rowColumns.end());
+		blockRowOffsets[i + 1] = (uint32_t)blockColumns.size();
+		diagonalBlocks[i] = rowBegin + (uint32_t)(std::lower_bound(rowColumns.begin(), rowColumns.end(), (uint32_t)i) - rowColumns.begin());
+
+		for (uint32_t a = (*adjacencyOffsets)[i]; a < (*adjacencyOffsets)[i + 1]; ++a)
+		{
+			const uint32_t s = (*adjacency)[a] >> 1;
+			const uint32_t column = ((*adjacency)[a] & 1) ? springs.particle1[s] : springs.particle2[s];
+			adjacencyBlocks[a] = rowBegin + (uint32_t)(std::lower_bound(rowColumns.begin(), rowColumns.end(), column) - rowColumns.begin());
+		}
+	}
+
+	blocks.resize(blockColumns.size());
+	preconditioner.resize(particleCount);
+	springJacobians.resize(springs.size());
+	for (std::vector<glm::vec3>* vector : { &rhs, &residual, &direction, &preconditioned, &product, &solution })
+		vector->assign(particleCount, glm::vec3(0.f));
+}
+
+void ImplicitSolver::solve(const Particles& particles, const Springs& springs, float mass, float timeStep, ThreadPool* pool)
+{
+	assemble(particles, springs, mass, timeStep, pool);
+
+	// Modified PCG: pinned particles are filtered out of every search direction, so their velocity change stays zero
+	filter(particles, solution, pool);
+	multiply(solution, product, pool);
+	parallelFor(pool, particles.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			residual[i] = rhs[i] - product[i];
+	});
+	filter(particles, residual, pool);
+	filter(particles, rhs, pool);
+
+	const double targetError = (double)tolerance * tolerance * dot(rhs, rhs, pool);
+	parallelFor(pool, particles.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			direction[i] = preconditioned[i] = preconditioner[i] * residual[i];
+	});
+
+	double residualDot = dot(residual, preconditioned, pool);
+	lastIterationCount = 0;
+	while (lastIterationCount < maxIterations && dot(residual, residual, pool) > targetError)
+	{
+		multiply(direction, product, pool);
+		filter(particles, product, pool);
+		const double curvature = dot(direction, product, pool);
+		if (curvature <= 0.0) break;
+
+		const float alpha = (float)(residualDot / curvature);
+		parallelFor(pool, particles.size(), [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+			{
+				solution[i] += alpha * direction[i];
+				residual[i] -= alpha * product[i];
+				preconditioned[i] = preconditioner[i] * residual[i];
+			}
+		});
+
+		const double newResidualDot = dot(residual, preconditioned, pool);
+		const float beta = (float)(newResidualDot / residualDot);
+		residualDot = newResidualDot;
+		parallelFor(pool, particles.size(), [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+				direction[i] = preconditioned[i] + beta * direction[i];
+		});
+
+		++lastIterationCount;
+	}
+}
+
+void ImplicitSolver::assemble(const Particles& particles, const Springs& springs, float mass, float timeStep, ThreadPool* pool)
+{
+	// Stiffness block of every spring, batch by batch; the transverse term is clamped so compressed springs keep the matrix definite
+	for (size_t b = 0; b < springs.getBatchCount(); ++b)
+	{
+		const uint32_t batchBegin = springs.getBatchBegin(b);
+		const float stiffness = springs.getBatchStiffness(b);
+		parallelFor(pool, springs.getBatchEnd(b) - batchBegin, [&](size_t begin, size_t end) {
+			for (size_t s = batchBegin + begin; s < batchBegin + end; ++s)
+			{
+				const glm::vec3 delta = particles.getPosition(springs.particle2[s]) - particles.getPosition(springs.particle1[s]);
+				const float length = glm::length(delta);
+				const glm::vec3 direction = delta / length;
+				const glm::mat3 longitudinal = glm::outerProduct(direction, direction);
+				const float transverse = std::max(0.f, 1.f - springs.restLength[s] / length);
+				springJacobians[s] = stiffness * (longitudinal + transverse * (glm::mat3(1.f) - longitudinal));
+			}
+		});
+	}
+
+	// Rows gather the blocks of their incident springs, so no two threads write the same block
+	const float timeStepSquared = timeStep * timeStep;
+	parallelFor(pool, particles.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			for (uint32_t b = blockRowOffsets[i]; b < blockRowOffsets[i + 1]; ++b)
+				blocks[b] = glm::mat3(0.f);
+
+			const glm::vec3 velocity = (particles.getPosition(i) - particles.getPreviousPosition(i)) / timeStep;
+			glm::mat3& diagonal = blocks[diagonalBlocks[i]];
+			diagonal = glm::mat3(mass);
+			glm::vec3 stiffnessTerm(0.f);
+			for (uint32_t a = (*adjacencyOffsets)[i]; a < (*adjacencyOffsets)[i + 1]; ++a)
+			{
+				const uint32_t s = (*adjacency)[a] >> 1;
+				const uint32_t neighbour = ((*adjacency)[a] & 1) ? springs.particle1[s] : springs.particle2[s];
+				const glm::vec3 neighbourVelocity = (particles.getPosition(neighbour) - particles.getPreviousPosition(neighbour)) / timeStep;
+				const glm::mat3 scaledJacobian = timeStepSquared * springJacobians[s];
+				diagonal += scaledJacobian;
+				blocks[adjacencyBlocks[a]] -= scaledJacobian;
+				stiffnessTerm += springJacobians[s] * (neighbourVelocity - velocity);
+			}
+
+			const glm::vec3 force(particles.forceX[i], particles.forceY[i], particles.forceZ[i]);
+			rhs[i] = timeStep * force + timeStepSquared * stiffnessTerm;
+			preconditioner[i] = glm::inverse(diagonal);
+		}
+	});
+}
+
+void ImplicitSolver::multiply(const std::vector<glm::vec3>& x, std::vector<glm::vec3>& result, ThreadPool* pool) const
+{
+	parallelFor(pool, x.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			glm::vec3 sum(0.f);
+			for (uint32_t b = blockRowOffsets[i]; b < blockRowOffsets[i + 1]; ++b)
+				sum += blocks[b] * x[blockColumns[b]];
+			result[i] = sum;
+		}
+	});
+}
+
+void ImplicitSolver::filter(const Particles& particles, std::vector<glm::vec3>& x, ThreadPool* pool) const
+{
+	parallelFor(pool, x.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			if (particles.inverseMass[i] == 0.f)
+				x[i] = glm::vec3(0.f);
+	});
+}
+
+double ImplicitSolver::dot(const std::vector<glm::vec3>& a, const std::vector<glm::vec3>& b, ThreadPool* pool) const
+{
+	return parallelSum(pool, a.size(), [&](size_t begin, size_t end) {
+		double sum = 0.0;
+		for (size_t i = begin; i < end; ++i)
+			sum += (double)glm::dot(a[i], b[i]);
+		return sum;
+	});
+}
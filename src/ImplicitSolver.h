@@ -0,0 +1,49 @@
+#pragma once
+#include "Particles.h"
+#include "Springs.h"
+#include "ThreadPool.h"
+#include <glm/mat3x3.hpp>
+#include <vector>
+
+// Backward Euler solver for the mass-spring system. Each step solves
+//     (M - h^2 K) dv = h (f + h K v)
+// for the velocity change dv, where K is the spring force Jacobian. The block-sparse 3x3 system
+// matrix reuses a sparsity pattern built once from the springs, and the system is solved with
+// block-Jacobi preconditioned conjugate gradients, warm-started from the previous step's solution.
+class ImplicitSolver {
+public:
+	void initialize(const Particles& particles, const Springs& springs, const std::vector<uint32_t>& adjacencyOffsets, const std::vector<uint32_t>& adjacency);
+	bool isInitialized() const { return !blockRowOffsets.empty(); }
+
+	// Particle forces have to hold the total force at the current positions
+	void solve(const Particles& particles, const Springs& springs, float mass, float timeStep, ThreadPool* pool);
+	const glm::vec3& getVelocityChange(size_t i) const { return solution[i]; }
+
+	void setMaxIterations(unsigned iterations) { maxIterations = iterations; }
+	void setTolerance(float relativeTolerance) { tolerance = relativeTolerance; }
+	unsigned getLastIterationCount() const { return lastIterationCount; }
+
+private:
+	void assemble(const Particles& particles, const Springs& springs, float mass, float timeStep, ThreadPool* pool);
+	void multiply(const std::vector<glm::vec3>& x, std::vector<glm::vec3>& result, ThreadPool* pool) const;
+	void filter(const Particles& particles, std::vector<glm::vec3>& x, ThreadPool* pool) const;
+	double dot(const std::vector<glm::vec3>& a, const std::vector<glm::vec3>& b, ThreadPool* pool) const;
+
+	// Block CSR pattern. adjacencyBlocks maps every entry of the spring adjacency to the off-diagonal
+	// block of its row that the spring contributes to.
+	std::vector<uint32_t> blockRowOffsets;
+	std::vector<uint32_t> blockColumns;
+	std::vector<uint32_t> diagonalBlocks;
+	std::vector<uint32_t> adjacencyBlocks;
+	const std::vector<uint32_t>* adjacencyOffsets = nullptr;
+	const std::vector<uint32_t>* adjacency = nullptr;
+
+	std::vector<glm::mat3> blocks;
+	std::vector<glm::mat3> preconditioner;
+	std::vector<glm::mat3> springJacobians;
+	std::vector<glm::vec3> rhs, residual, direction, preconditioned, product, solution;
+
+	unsigned maxIterations = 100;
+	float tolerance = 1e-4f;
+	unsigned lastIterationCount = 0;
+};
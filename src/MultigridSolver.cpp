@@ -0,0 +1,283 @@
+#include "MultigridSolver.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+
+namespace {
+
+// Every second index of 0 .. count - 1, and the last one
+std::vector<size_t> coarsenIndices(size_t count)
+{
+	std::vector<size_t> indices;
+	for (size_t i = 0; i < count; i += 2)
+		indices.push_back(i);
+	if (indices.back() != count - 1)
+		indices.push_back(count - 1);
+	return indices;
+}
+
+// Position of fine index i between the coarse indices: the lower coarse index and the weight of the upper one
+void locate(const std::vector<size_t>& coarseIndices, size_t i, size_t& lower, float& weight)
+{
+	lower = std::upper_bound(coarseIndices.begin(), coarseIndices.end(), i) - coarseIndices.begin() - 1;
+	if (lower + 1 >= coarseIndices.size())
+	{
+		lower = coarseIndices.size() - 2;
+		weight = 1.f;
+		return;
+	}
+	weight = (float)(i - coarseIndices[lower]) / (float)(coarseIndices[lower + 1] - coarseIndices[lower]);
+}
+
+// Gradient of the incremental potential at particle i: inertia (x - y) minus the spring forces. Zero when pinned.
+glm::vec3 computeResidual(const Particles& particles, const Springs& springs, const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& entries,
+	float inertia, const float* targetX, const float* targetY, const float* targetZ, size_t i)
+{
+	if (particles.inverseMass[i] == 0.f)
+		return glm::vec3(0.f);
+
+	const glm::vec3 position = particles.getPosition(i);
+	glm::vec3 residual = inertia * (position - glm::vec3(targetX[i], targetY[i], targetZ[i]));
+	for (uint32_t a = offsets[i]; a < offsets[i + 1]; ++a)
+	{
+		const uint32_t s = entries[a] >> 1;
+		const uint32_t neighbour = (entries[a] & 1) ? springs.particle1[s] : springs.particle2[s];
+		const glm::vec3 delta = particles.getPosition(neighbour) - position;
+		const float length = glm::length(delta);
+		if (length == 0.f) continue;
+		residual -= springs.stiffness[s] * (length - springs.restLength[s]) * (delta / length);
+	}
+	return residual;
+}
+
+}
+
+void MultigridSolver::initialize(const Particles& particles, size_t width, size_t height, const std::vector<uint32_t>& particleSlots, const float* typeStiffness,
+	const Coloring& vertexColoring, const std::vector<uint32_t>& _adjacencyOffsets, const std::vector<uint32_t>& _adjacency)
+{
+	smoother.initialize(particles, vertexColoring, _adjacencyOffsets, _adjacency);
+	smoother.setIterations(smoothingIterations);
+	adjacencyOffsets = &_adjacencyOffsets;
+	adjacency = &_adjacency;
+
+	const std::vector<size_t> columns = coarsenIndices(width);
+	const std::vector<size_t> rows = coarsenIndices(height);
+	coarseWidth = columns.size();
+	coarseHeight = rows.size();
+	coarse.resize(coarseWidth * coarseHeight);
+	injection.resize(coarse.size());
+	for (size_t r = 0; r < coarseHeight; ++r)
+	{
+		for (size_t c = 0; c < coarseWidth; ++c)
+			injection[r * coarseWidth + c] = particleSlots[rows[r] * width + columns[c]];
+	}
+
+	// Bilinear weights of the four surrounding coarse particles
+	prolongation.resize(particles.size());
+	for (size_t row = 0; row < height; ++row)
+	{
+		size_t r;
+		float rowWeight;
+		locate(rows, row, r, rowWeight);
+		for (size_t column = 0; column < width; ++column)
+		{
+			size_t c;
+			float columnWeight;
+			locate(columns, column, c, columnWeight);
+			Prolongation& entry = prolongation[particleSlots[row * width + column]];
+			entry.coarse[0] = (uint32_t)(r * coarseWidth + c);
+			entry.coarse[1] = (uint32_t)(r * coarseWidth + c + 1);
+			entry.coarse[2] = (uint32_t)((r + 1) * coarseWidth + c);
+			entry.coarse[3] = (uint32_t)((r + 1) * coarseWidth + c + 1);
+			entry.weight[0] = (1.f - rowWeight) * (1.f - columnWeight);
+			entry.weight[1] = (1.f - rowWeight) * columnWeight;
+			entry.weight[2] = rowWeight * (1.f - columnWeight);
+			entry.weight[3] = rowWeight * columnWeight;
+		}
+	}
+
+	// The coarse grid gets the same spring pattern as the cloth: structural and shear springs to the next row and
+	// column, bending springs to the second next
+	enum { Structural, Shear, Bending };
+	coarseSprings = Springs();
+	for (size_t r = 0; r < coarseHeight; ++r)
+	{
+		for (size_t c = 0; c < coarseWidth; ++c)
+		{
+			const uint32_t i = (uint32_t)(r * coarseWidth + c);
+			if (c + 1 < coarseWidth) coarseSprings.add(i, i + 1, Structural);
+			if (r + 1 < coarseHeight) coarseSprings.add(i, i + (uint32_t)coarseWidth, Structural);
+			if (c + 1 < coarseWidth && r + 1 < coarseHeight)
+			{
+				coarseSprings.add(i, i + (uint32_t)coarseWidth + 1, Shear);
+				coarseSprings.add(i + 1, i + (uint32_t)coarseWidth, Shear);
+			}
+			if (c + 2 < coarseWidth) coarseSprings.add(i, i + 2, Bending);
+			if (r + 2 < coarseHeight) coarseSprings.add(i, i + 2 * (uint32_t)coarseWidth, Bending);
+		}
+	}
+	coarseSprings.buildBatches(typeStiffness);
+
+	coarseAdjacencyOffsets.assign(coarse.size() + 1, 0);
+	for (size_t s = 0; s < coarseSprings.size(); ++s)
+	{
+		++coarseAdjacencyOffsets[coarseSprings.particle1[s] + 1];
+		++coarseAdjacencyOffsets[coarseSprings.particle2[s] + 1];
+	}
+	for (size_t i = 0; i < coarse.size(); ++i)
+		coarseAdjacencyOffsets[i + 1] += coarseAdjacencyOffsets[i];
+	std::vector<uint32_t> fill(coarseAdjacencyOffsets.begin(), coarseAdjacencyOffsets.end() - 1);
+	coarseAdjacency.resize(2 * coarseSprings.size());
+	for (size_t s = 0; s < coarseSprings.size(); ++s)
+	{
+		coarseAdjacency[fill[coarseSprings.particle1[s]]++] = (uint32_t)s << 1;
+		coarseAdjacency[fill[coarseSprings.particle2[s]]++] = ((uint32_t)s << 1) | 1;
+	}
+
+	for (std::vector<float>* buffer : { &predictionX, &predictionY, &predictionZ, &residualX, &residualY, &residualZ, &correctedX, &correctedY, &correctedZ })
+		buffer->resize(particles.size());
+	for (std::vector<float>* buffer : { &coarseStartX, &coarseStartY, &coarseStartZ, &coarseTargetX, &coarseTargetY, &coarseTargetZ,
+		&coarseResidualX, &coarseResidualY, &coarseResidualZ })
+		buffer->resize(coarse.size());
+
+	// The coarse grid is row-major, so its slots are its grid indices
+	const Coloring coarseColoring = colorGrid(coarseWidth, coarseHeight, 2);
+	if (coarseWidth / 2 + 1 >= minCoarseSize && coarseHeight / 2 + 1 >= minCoarseSize)
+	{
+		std::vector<uint32_t> coarseSlots(coarse.size());
+		for (size_t i = 0; i < coarseSlots.size(); ++i)
+			coarseSlots[i] = (uint32_t)i;
+		if (!coarser)
+			coarser.reset(new MultigridSolver());
+		coarser->setIterations(coarsestIterations);
+		coarser->setSmoothingIterations(smoothingIterations);
+		coarser->initialize(coarse, coarseWidth, coarseHeight, coarseSlots, typeStiffness, coarseColoring, coarseAdjacencyOffsets, coarseAdjacency);
+	}
+	else
+	{
+		coarser.reset();
+		coarsestSolver.initialize(coarse, coarseColoring, coarseAdjacencyOffsets, coarseAdjacency);
+		coarsestSolver.setIterations(coarsestIterations);
+	}
+}
+
+void MultigridSolver::setIterations(unsigned count)
+{
+	coarsestIterations = count;
+	coarsestSolver.setIterations(count);
+	if (coarser)
+		coarser->setIterations(count);
+}
+
+void MultigridSolver::setSmoothingIterations(unsigned count)
+{
+	smoothingIterations = count;
+	smoother.setIterations(count);
+	if (coarser)
+		coarser->setSmoothingIterations(count);
+}
+
+void MultigridSolver::solve(Particles& particles, const Springs& springs, float mass, float timeStep, ThreadPool* pool)
+{
+	solve(particles, springs, mass, timeStep, pool, nullptr, nullptr, nullptr);
+}
+
+void MultigridSolver::solve(Particles& particles, const Springs& springs, float mass, float timeStep, ThreadPool* pool, const float* startX, const float* startY, const float* startZ)
+{
+	// Pre-smoothing towards the prediction, which stays the inertial target on this level
+	std::copy(particles.x.begin(), particles.x.end(), predictionX.begin());
+	std::copy(particles.y.begin(), particles.y.end(), predictionY.begin());
+	std::copy(particles.z.begin(), particles.z.end(), predictionZ.begin());
+	smoother.solve(particles, springs, mass, timeStep, pool, startX, startY, startZ);
+
+	const float inertia = mass / (timeStep * timeStep);
+	parallelFor(pool, particles.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			const glm::vec3 residual = computeResidual(particles, springs, *adjacencyOffsets, *adjacency, inertia,
+				predictionX.data(), predictionY.data(), predictionZ.data(), i);
+			residualX[i] = residual.x;
+			residualY[i] = residual.y;
+			residualZ[i] = residual.z;
+		}
+	});
+
+	// Restriction: the coarse grid starts from the injected iterate, and the fine residual is gathered with the
+	// transposed interpolation weights
+	for (size_t k = 0; k < coarse.size(); ++k)
+	{
+		const uint32_t slot = injection[k];
+		coarse.x[k] = coarseStartX[k] = particles.x[slot];
+		coarse.y[k] = coarseStartY[k] = particles.y[slot];
+		coarse.z[k] = coarseStartZ[k] = particles.z[slot];
+		coarseTargetX[k] = predictionX[slot];
+		coarseTargetY[k] = predictionY[slot];
+		coarseTargetZ[k] = predictionZ[slot];
+		coarse.restX[k] = particles.restX[slot];
+		coarse.restY[k] = particles.restY[slot];
+		coarse.restZ[k] = particles.restZ[slot];
+		coarse.inverseMass[k] = particles.inverseMass[slot];
+	}
+	for (size_t s = 0; s < coarseSprings.size(); ++s)
+		coarseSprings.restLength[s] = glm::length(coarse.getRestPosition(coarseSprings.particle2[s]) - coarse.getRestPosition(coarseSprings.particle1[s]));
+
+	std::fill(coarseResidualX.begin(), coarseResidualX.end(), 0.f);
+	std::fill(coarseResidualY.begin(), coarseResidualY.end(), 0.f);
+	std::fill(coarseResidualZ.begin(), coarseResidualZ.end(), 0.f);
+	for (size_t i = 0; i < particles.size(); ++i)
+	{
+		const Prolongation& entry = prolongation[i];
+		for (int n = 0; n < 4; ++n)
+		{
+			coarseResidualX[entry.coarse[n]] += entry.weight[n] * residualX[i];
+			coarseResidualY[entry.coarse[n]] += entry.weight[n] * residualY[i];
+			coarseResidualZ[entry.coarse[n]] += entry.weight[n] * residualZ[i];
+		}
+	}
+
+	// Every coarse particle stands for a 2 x 2 block of fine ones. Its prediction is shifted so that the gradient of
+	// the coarse potential at the injected iterate equals the restricted fine residual; a converged fine iterate
+	// then gets no correction.
+	const float coarseMass = 4.f * mass;
+	const float coarseInertia = coarseMass / (timeStep * timeStep);
+	for (size_t k = 0; k < coarse.size(); ++k)
+	{
+		const glm::vec3 coarseResidual = computeResidual(coarse, coarseSprings, coarseAdjacencyOffsets, coarseAdjacency, coarseInertia,
+			coarseTargetX.data(), coarseTargetY.data(), coarseTargetZ.data(), k);
+		coarseTargetX[k] += (coarseResidual.x - coarseResidualX[k]) / coarseInertia;
+		coarseTargetY[k] += (coarseResidual.y - coarseResidualY[k]) / coarseInertia;
+		coarseTargetZ[k] += (coarseResidual.z - coarseResidualZ[k]) / coarseInertia;
+	}
+	std::copy(coarseTargetX.begin(), coarseTargetX.end(), coarse.x.begin());
+	std::copy(coarseTargetY.begin(), coarseTargetY.end(), coarse.y.begin());
+	std::copy(coarseTargetZ.begin(), coarseTargetZ.end(), coarse.z.begin());
+
+	if (coarser)
+		coarser->solve(coarse, coarseSprings, coarseMass, timeStep, pool, coarseStartX.data(), coarseStartY.data(), coarseStartZ.data());
+	else
+		coarsestSolver.solve(coarse, coarseSprings, coarseMass, timeStep, pool, coarseStartX.data(), coarseStartY.data(), coarseStartZ.data());
+
+	// The coarse correction is interpolated onto the smoothed iterate and smoothed once more
+	parallelFor(pool, particles.size(), [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			glm::vec3 correction(0.f);
+			if (particles.inverseMass[i] != 0.f)
+			{
+				const Prolongation& entry = prolongation[i];
+				for (int n = 0; n < 4; ++n)
+				{
+					const uint32_t c = entry.coarse[n];
+					correction += entry.weight[n] * glm::vec3(coarse.x[c] - coarseStartX[c], coarse.y[c] - coarseStartY[c], coarse.z[c] - coarseStartZ[c]);
+				}
+			}
+			correctedX[i] = particles.x[i] + correction.x;
+			correctedY[i] = particles.y[i] + correction.y;
+			correctedZ[i] = particles.z[i] + correction.z;
+		}
+	});
+
+	std::copy(predictionX.begin(), predictionX.end(), particles.x.begin());
+	std::copy(predictionY.begin(), predictionY.end(), particles.y.begin());
+	std::copy(predictionZ.begin(), predictionZ.end(), particles.z.begin());
+	smoother.solve(particles, springs, mass, timeStep, pool, correctedX.data(), correctedY.data(), correctedZ.data());
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "Particles.h"
+#include "Springs.h"
+#include "GraphColoring.h"
+#include "VBDSolver.h"
+#include "ThreadPool.h"
+#include <vector>
+#include <memory>
+
+// Multi-resolution vertex block descent, as a full approximation scheme V-cycle. The grid is coarsened to every
+// second row and column (plus the last ones, so the corner pins survive) with springs of the same stiffness per
+// type and four times the particle mass. A few VBD sweeps smooth the fine iterate, the coarse grid then minimizes
+// its own incremental potential, shifted by the restricted fine residual so that a converged fine iterate is left
+// alone, recursively down to a grid a few particles wide. Its correction is interpolated bilinearly back onto the
+// fine grid and smoothed again. Stretch so travels across the cloth in a few iterations instead of one particle
+// per sweep.
+class MultigridSolver {
+public:
+	// The grid is width x height in original row-major indices, particleSlots maps them to memory slots
+	void initialize(const Particles& particles, size_t width, size_t height, const std::vector<uint32_t>& particleSlots, const float* typeStiffness,
+		const Coloring& vertexColoring, const std::vector<uint32_t>& adjacencyOffsets, const std::vector<uint32_t>& adjacency);
+	bool isInitialized() const { return coarseWidth > 0; }
+
+	// Particle positions have to hold the inertial prediction y, they are replaced by the solution
+	void solve(Particles& particles, const Springs& springs, float mass, float timeStep, ThreadPool* pool);
+
+	// Same, but the cycle starts from the given positions instead of from the prediction
+	void solve(Particles& particles, const Springs& springs, float mass, float timeStep, ThreadPool* pool, const float* startX, const float* startY, const float* startZ);
+
+	// VBD iterations on the coarsest grid, and smoothing iterations before and after the coarse correction on every
+	// finer one
+	void setIterations(unsigned count);
+	unsigned getIterations() const { return coarsestIterations; }
+	void setSmoothingIterations(unsigned count);
+	unsigned getSmoothingIterations() const { return smoothingIterations; }
+	size_t getLevelCount() const { return coarser ? coarser->getLevelCount() + 1 : 2; }
+
+	// Grids narrower than this in either direction are not coarsened any further
+	static constexpr size_t minCoarseSize = 8;
+
+private:
+	// Fine slot of every coarse particle, and the four coarse particles interpolated into every fine slot. The
+	// transposed weights restrict the residual.
+	struct Prolongation {
+		uint32_t coarse[4];
+		float weight[4];
+	};
+
+	const std::vector<uint32_t>* adjacencyOffsets = nullptr;
+	const std::vector<uint32_t>* adjacency = nullptr;
+	size_t coarseWidth = 0;
+	size_t coarseHeight = 0;
+	std::vector<uint32_t> injection;
+	std::vector<Prolongation> prolongation;
+	Particles coarse;
+	Springs coarseSprings;
+	std::vector<uint32_t> coarseAdjacencyOffsets;
+	std::vector<uint32_t> coarseAdjacency;
+	std::vector<float> predictionX, predictionY, predictionZ;
+	std::vector<float> residualX, residualY, residualZ;
+	std::vector<float> coarseStartX, coarseStartY, coarseStartZ;
+	std::vector<float> coarseTargetX, coarseTargetY, coarseTargetZ;
+	std::vector<float> coarseResidualX, coarseResidualY, coarseResidualZ;
+	std::vector<float> correctedX, correctedY, correctedZ;
+	VBDSolver smoother;
+	VBDSolver coarsestSolver;
+	std::unique_ptr<MultigridSolver> coarser;
+	unsigned coarsestIterations = 10;
+	unsigned smoothingIterations = 1;
+};
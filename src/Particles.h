@@ -0,0 +1,43 @@
+#pragma once
+#include <glm/vec3.hpp>
+#include <vector>
+#include <cstdint>
+
+// Structure-of-arrays particle storage. Each component lives in its own contiguous
+// array so the integration and force passes stream through memory linearly.
+struct Particles {
+	void resize(size_t count)
+	{
+		for (std::vector<float>* component : { &x, &y, &z, &previousX, &previousY, &previousZ, &forceX, &forceY, &forceZ, &restX, &restY, &restZ })
+			component->resize(count, 0.f);
+		inverseMass.resize(count, 1.f);
+	}
+
+	// Moves particle source[k] to slot k for every k
+	void permute(const std::vector<uint32_t>& source)
+	{
+		std::vector<float> scratch(size());
+		for (std::vector<float>* component : { &x, &y, &z, &previousX, &previousY, &previousZ, &forceX, &forceY, &forceZ, &restX, &restY, &restZ, &inverseMass })
+		{
+			for (size_t k = 0; k < source.size(); ++k)
+				scratch[k] = (*component)[source[k]];
+			component->swap(scratch);
+		}
+	}
+
+	size_t size() const { return x.size(); }
+	glm::vec3 getPosition(size_t i) const { return glm::vec3(x[i], y[i], z[i]); }
+	glm::vec3 getPreviousPosition(size_t i) const { return glm::vec3(previousX[i], previousY[i], previousZ[i]); }
+	glm::vec3 getRestPosition(size_t i) const { return glm::vec3(restX[i], restY[i], restZ[i]); }
+
+	// World-space positions
+	std::vector<float> x, y, z;
+	std::vector<float> previousX, previousY, previousZ;
+	std::vector<float> forceX, forceY, forceZ;
+
+	// World-space rest positions, i.e. the model-space grid point transformed by the cloth transform
+	std::vector<float> restX, restY, restZ;
+
+	// Zero for pinned particles
+	std::vector<float> inverseMass;
+};
@@ -0,0 +1,92 @@
+#include "PhysicsThread.h"
+#include <chrono>
+
+PhysicsThread::PhysicsThread(Cloth& _cloth, float _timeStep, unsigned _maxStepsPerTick) : 
+	cloth(_cloth), timeStep(_timeStep), maxStepsPerTick(_maxStepsPerTick)
+{
+}
+
+PhysicsThread::~PhysicsThread()
+{
+	stop();
+}
+
+void PhysicsThread::start()
+{
+	if (running) return;
+	running = true;
+	thread = std::thread(&PhysicsThread::run, this);
+}
+
+void PhysicsThread::stop()
+{
+	running = false;
+	if (thread.joinable())
+		thread.join();
+}
+
+void PhysicsThread::setColliders(const CollisionWorld& _colliders)
+{
+	std::lock_guard<std::mutex> lock(collidersMutex);
+	colliders = _colliders;
+}
+
+bool PhysicsThread::readTranslations(std::vector<glm::vec3>& translations)
+{
+	if (!(readyIndex.load(std::memory_order_relaxed) & freshBit))
+		return false;
+
+	readIndex = readyIndex.exchange(readIndex, std::memory_order_acq_rel) & ~freshBit;
+	translations = buffers[readIndex];
+	return true;
+}
+
+void PhysicsThread::run()
+{
+	using Clock = std::chrono::steady_clock;
+	const Clock::duration step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(timeStep));
+	Time t;
+	t.deltaTime = timeStep;
+	t.lastDeltaTime = timeStep;
+	t.frameRate = 1.f / timeStep;
+
+	// Copied under the lock once per tick, reusing its storage
+	CollisionWorld currentColliders;
+	Clock::duration accumulator = Clock::duration::zero();
+	Clock::time_point last = Clock::now();
+	while (running)
+	{
+		const Clock::time_point now = Clock::now();
+		accumulator += now - last;
+		last = now;
+
+		// After a long stall drop the backlog instead of trying to catch up with it
+		if (accumulator > step * maxStepsPerTick)
+			accumulator = step * maxStepsPerTick;
+
+		if (accumulator >= step)
+		{
+			{
+				std::lock_guard<std::mutex> lock(collidersMutex);
+				currentColliders = colliders;
+			}
+
+			while (accumulator >= step)
+			{
+				cloth.updatePhysics(t, currentColliders);
+				t.runningTime += timeStep;
+				accumulator -= step;
+			}
+
+			publish();
+		}
+
+		std::this_thread::sleep_for(step - accumulator);
+	}
+}
+
+void PhysicsThread::publish()
+{
+	cloth.getTranslations(buffers[writeIndex]);
+	writeIndex = readyIndex.exchange(writeIndex | freshBit, std::memory_order_acq_rel) & ~freshBit;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "Cloth.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Advances a cloth on a dedicated thread with a fixed-step clock. Render threads pick up the
+// latest finished state through readTranslations, which never waits on the simulation.
+class PhysicsThread {
+public:
+	PhysicsThread(Cloth& cloth, float timeStep = 1.f / 240.f, unsigned maxStepsPerTick = 8);
+	~PhysicsThread();
+	PhysicsThread(const PhysicsThread&) = delete;
+	PhysicsThread& operator=(const PhysicsThread&) = delete;
+	void start();
+	void stop();
+	void setColliders(const CollisionWorld& colliders);
+
+	// Copies the most recently published translations into the argument. Returns false, leaving it
+	// untouched, if no step has been published since the previous call.
+	bool readTranslations(std::vector<glm::vec3>& translations);
+	float getTimeStep() const { return timeStep; }
+
+private:
+	void run();
+	void publish();
+
+	Cloth& cloth;
+	const float timeStep;
+	const unsigned maxStepsPerTick;
+	std::thread thread;
+	std::atomic<bool> running{ false };
+
+	std::mutex collidersMutex;
+	CollisionWorld colliders;
+
+	// Triple buffer: the simulation fills writeIndex, the renderer holds readIndex and the third slot
+	// is exchanged between them through readyIndex, whose fresh bit marks an unread publication.
+	static constexpr unsigned freshBit = 4;
+	std::vector<glm::vec3> buffers[3];
+	unsigned writeIndex = 0;
+	unsigned readIndex = 1;
+	std::atomic<unsigned> readyIndex{ 2 };
+};
@@ -0,0 +1,129 @@
+#include "ProjectiveDynamicsSolver.h"
+#include <glm/glm.hpp>
+
+void ProjectiveDynamicsSolver::initialize(const Particles& particles, const Springs& springs, const std::vector<uint32_t>& _adjacencyOffsets, const std::vector<uint32_t>& _adjacency)
+{
+	adjacencyOffsets = &_adjacencyOffsets;
+	adjacency = &_adjacency;
+	factorizedTimeStep = 0.f;
+	projectionX.resize(springs.size());
+	projectionY.resize(springs.size());
+	projectionZ.resize(springs.size());
+	rhs.resize(3 * particles.size());
+	workspace.resize(3 * particles.size());
+}
+
+bool ProjectiveDynamicsSolver::factorize(const Particles& particles, const Springs& springs, float mass, float timeStep)
+{
+	// Pinned particles get identity rows, their coupling to free neighbours moves to the right-hand side
+	std::vector<SparseCholesky::Entry> entries;
+	entries.reserve(particles.size() + 3 * springs.size());
+	const double inertia = mass / ((double)timeStep * timeStep);
+	for (size_t i = 0; i < particles.size(); ++i)
+		entries.push_back({ (uint32_t)i, (uint32_t)i, particles.inverseMass[i] == 0.f ? 1.0 : inertia });
+
+	for (size_t b = 0; b < springs.getBatchCount(); ++b)
+	{
+		const double stiffness = springs.getBatchStiffness(b);
+		for (size_t s = springs.getBatchBegin(b); s < springs.getBatchEnd(b); ++s)
+		{
+			const uint32_t p1 = springs.particle1[s];
+			const uint32_t p2 = springs.particle2[s];
+			const bool free1 = particles.inverseMass[p1] != 0.f;
+			const bool free2 = particles.inverseMass[p2] != 0.f;
+			if (free1) entries.push_back({ p1, p1, stiffness });
+			if (free2) entries.push_back({ p2, p2, stiffness });
+			if (free1 && free2) entries.push_back({ p1, p2, -stiffness });
+		}
+	}
+
+	// A failed factorization leaves no usable factor, so the next solve has to try again
+	factorizedTimeStep = 0.f;
+	if (!cholesky.factorize(particles.size(), entries))
+		return false;
+	factorizedTimeStep = timeStep;
+	return true;
+}
+
+bool ProjectiveDynamicsSolver::solve(Particles& particles, const Springs& springs, float mass, float timeStep, ThreadPool* pool)
+{
+	if (timeStep != factorizedTimeStep && !factorize(particles, springs, mass, timeStep))
+		return false;
+
+	inertialX = particles.x;
+	inertialY = particles.y;
+	inertialZ = particles.z;
+	const double inertia = mass / ((double)timeStep * timeStep);
+	for (unsigned iteration = 0; iteration < iterations; ++iteration)
+	{
+		// Local step: the closest configuration of every spring that has its rest length, scaled by the
+		// stiffness of its batch so the gather below needs no per-spring stiffness
+		for (size_t b = 0; b < springs.getBatchCount(); ++b)
+		{
+			const uint32_t batchBegin = springs.getBatchBegin(b);
+			const float stiffness = springs.getBatchStiffness(b);
+			parallelFor(pool, springs.getBatchEnd(b) - batchBegin, [&](size_t begin, size_t end) {
+				for (size_t s = batchBegin + begin; s < batchBegin + end; ++s)
+				{
+					const glm::vec3 delta = particles.getPosition(springs.particle2[s]) - particles.getPosition(springs.particle1[s]);
+					const float length = glm::length(delta);
+					const glm::vec3 projection = length > 0.f ? delta * (stiffness * springs.restLength[s] / length) : glm::vec3(0.f);
+					projectionX[s] = projection.x;
+					projectionY[s] = projection.y;
+					projectionZ[s] = projection.z;
+				}
+			});
+		}
+
+		// Right-hand side gathered per particle through the spring adjacency
+		parallelFor(pool, particles.size(), [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+			{
+				if (particles.inverseMass[i] == 0.f)
+				{
+					rhs[3 * i] = particles.x[i];
+					rhs[3 * i + 1] = particles.y[i];
+					rhs[3 * i + 2] = particles.z[i];
+					continue;
+				}
+
+				double sumX = inertia * inertialX[i], sumY = inertia * inertialY[i], sumZ = inertia * inertialZ[i];
+				for (uint32_t a = (*adjacencyOffsets)[i]; a < (*adjacencyOffsets)[i + 1]; ++a)
+				{
+					const uint32_t s = (*adjacency)[a] >> 1;
+					const bool second = (*adjacency)[a] & 1;
+					const double sign = second ? 1.0 : -1.0;
+					sumX += sign * projectionX[s];
+					sumY += sign * projectionY[s];
+					sumZ += sign * projectionZ[s];
+
+					const uint32_t neighbour = second ? springs.particle1[s] : springs.particle2[s];
+					if (particles.inverseMass[neighbour] == 0.f)
+					{
+						const double stiffness = springs.stiffness[s];
+						sumX += stiffness * particles.x[neighbour];
+						sumY += stiffness * particles.y[neighbour];
+						sumZ += stiffness * particles.z[neighbour];
+					}
+				}
+
+				rhs[3 * i] = sumX;
+				rhs[3 * i + 1] = sumY;
+				rhs[3 * i + 2] = sumZ;
+			}
+		});
+
+		// Global step: one pass over the factor solves all three coordinates
+		cholesky.solve(rhs.data(), 3, workspace.data());
+
+		parallelFor(pool, particles.size(), [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+			{
+				particles.x[i] = (float)rhs[3 * i];
+				particles.y[i] = (float)rhs[3 * i + 1];
+				particles.z[i] = (float)rhs[3 * i + 2];
+			}
+		});
+	}
+	return true;
+}
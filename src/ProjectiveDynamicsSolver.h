@@ -0,0 +1,36 @@
+#pragma once
+#include "Particles.h"
+#include "Springs.h"
+#include "SparseCholesky.h"
+#include "ThreadPool.h"
+#include <vector>
+
+// Projective dynamics for the mass-spring system. The local step projects every spring onto its rest
+// length in parallel; the global step solves (M / h^2 + L) x = M / h^2 y + J d with the spring Laplacian L.
+// The global matrix only depends on topology, masses, stiffnesses and the timestep, so it is factored
+// once and every iteration costs one forward and back substitution for all three coordinates.
+class ProjectiveDynamicsSolver {
+public:
+	void initialize(const Particles& particles, const Springs& springs, const std::vector<uint32_t>& adjacencyOffsets, const std::vector<uint32_t>& adjacency);
+	bool isInitialized() const { return adjacencyOffsets != nullptr; }
+
+	// Particle positions have to hold the inertial prediction y, they are replaced by the solution. False, with the
+	// positions left at the prediction, if the global matrix could not be factored.
+	bool solve(Particles& particles, const Springs& springs, float mass, float timeStep, ThreadPool* pool);
+
+	void setIterations(unsigned count) { iterations = count; }
+	unsigned getIterations() const { return iterations; }
+
+private:
+	bool factorize(const Particles& particles, const Springs& springs, float mass, float timeStep);
+
+	const std::vector<uint32_t>* adjacencyOffsets = nullptr;
+	const std::vector<uint32_t>* adjacency = nullptr;
+	SparseCholesky cholesky;
+	float factorizedTimeStep = 0.f;
+	std::vector<float> inertialX, inertialY, inertialZ;
+	std::vector<float> projectionX, projectionY, projectionZ;
+	std::vector<double> rhs;	// x, y and z interleaved per particle
+	std::vector<double> workspace;
+	unsigned iterations = 10;
+};
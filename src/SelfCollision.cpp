@@ -0,0 +1,232 @@
+#include "SelfCollision.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+
+void SelfCollision::initialize(const Springs& springs, const std::vector<uint32_t>& adjacencyOffsets, const std::vector<uint32_t>& adjacency)
+{
+	const size_t particleCount = adjacencyOffsets.size() - 1;
+	neighbourOffsets.assign(particleCount + 1, 0);
+	neighbours.clear();
+	neighbours.reserve(adjacency.size());
+	for (size_t i = 0; i < particleCount; ++i)
+	{
+		const size_t first = neighbours.size();
+		for (uint32_t a = adjacencyOffsets[i]; a < adjacencyOffsets[i + 1]; ++a)
+		{
+			const uint32_t s = adjacency[a] >> 1;
+			neighbours.push_back((adjacency[a] & 1) ? springs.particle1[s] : springs.particle2[s]);
+		}
+		std::sort(neighbours.begin() + first, neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin() + first, neighbours.end()), neighbours.end());
+		neighbourOffsets[i + 1] = (uint32_t)neighbours.size();
+	}
+
+	// At least twice as many buckets as particles, to keep cells that share a bucket rare, and a power of two so
+	// that bucket indices wrap with a mask
+	size_t bucketCount = 4;
+	while (bucketCount < 2 * particleCount)
+		bucketCount <<= 1;
+	bucketMask = (uint32_t)bucketCount - 1;
+	bucketCounts = std::vector<std::atomic<uint32_t>>(bucketCount);
+	bucketStarts.assign(bucketCount + 1, 0);
+	blockSums.assign((bucketCount + prefixBlockSize - 1) / prefixBlockSize, 0);
+	particleBuckets.resize(particleCount);
+	sortedParticles.resize(particleCount);
+	sortedPositions.resize(particleCount);
+	corrections.resize(particleCount);
+}
+
+uint32_t SelfCollision::getBucket(int32_t x, int32_t y, int32_t z) const
+{
+	// Only y and z are hashed, so that the cell after x is in the bucket after it. The final mix spreads flat sheets
+	// of cells over the whole table; the plain product hash lines their rows up in a few stretches of it.
+	uint32_t hash = (uint32_t)y * 73856093u ^ (uint32_t)z * 19349663u;
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	return (hash + (uint32_t)x) & bucketMask;
+}
+
+bool SelfCollision::areNeighbours(uint32_t a, uint32_t b) const
+{
+	return std::binary_search(neighbours.begin() + neighbourOffsets[a], neighbours.begin() + neighbourOffsets[a + 1], b);
+}
+
+void SelfCollision::buildHash(const Particles& particles, float inverseCellSize, ThreadPool* pool)
+{
+	const size_t particleCount = particles.size();
+	const size_t bucketCount = (size_t)bucketMask + 1;
+	parallelFor(pool, bucketCount, [&](size_t begin, size_t end) {
+		for (size_t b = begin; b < end; ++b)
+			bucketCounts[b].store(0, std::memory_order_relaxed);
+	});
+
+	parallelFor(pool, particleCount, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			const uint32_t bucket = getBucket((int32_t)std::floor(particles.x[i] * inverseCellSize), (int32_t)std::floor(particles.y[i] * inverseCellSize),
+				(int32_t)std::floor(particles.z[i] * inverseCellSize));
+			particleBuckets[i] = bucket;
+			bucketCounts[bucket].fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+
+	// Exclusive prefix sum of the counts: the total of every block, the prefix of those, then the prefix within
+	// every block, which also turns the counts into the cursors of the scatter
+	const size_t blockCount = blockSums.size();
+	parallelFor(pool, blockCount, [&](size_t begin, size_t end) {
+		for (size_t block = begin; block < end; ++block)
+		{
+			uint32_t sum = 0;
+			for (size_t b = block * prefixBlockSize; b < std::min(bucketCount, (block + 1) * prefixBlockSize); ++b)
+				sum += bucketCounts[b].load(std::memory_order_relaxed);
+			blockSums[block] = sum;
+		}
+	});
+	uint32_t total = 0;
+	for (uint32_t& sum : blockSums)
+	{
+		const uint32_t blockTotal = sum;
+		sum = total;
+		total += blockTotal;
+	}
+	parallelFor(pool, blockCount, [&](size_t begin, size_t end) {
+		for (size_t block = begin; block < end; ++block)
+		{
+			uint32_t start = blockSums[block];
+			for (size_t b = block * prefixBlockSize; b < std::min(bucketCount, (block + 1) * prefixBlockSize); ++b)
+			{
+				const uint32_t count = bucketCounts[b].load(std::memory_order_relaxed);
+				bucketStarts[b] = start;
+				bucketCounts[b].store(start, std::memory_order_relaxed);
+				start += count;
+			}
+		}
+	});
+	bucketStarts[bucketCount] = total;
+
+	parallelFor(pool, particleCount, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			sortedParticles[bucketCounts[particleBuckets[i]].fetch_add(1, std::memory_order_relaxed)] = (uint32_t)i;
+	});
+
+	// The order within a bucket depends on the threads; sorting it by particle makes the corrections the same on any
+	// number of threads. Buckets hold a particle or two, so insertion sort does.
+	parallelFor(pool, bucketCount, [&](size_t begin, size_t end) {
+		for (size_t b = begin; b < end; ++b)
+		{
+			for (uint32_t k = bucketStarts[b] + 1; k < bucketStarts[b + 1]; ++k)
+			{
+				const uint32_t particle = sortedParticles[k];
+				uint32_t position = k;
+				for (; position > bucketStarts[b] && sortedParticles[position - 1] > particle; --position)
+					sortedParticles[position] = sortedParticles[position - 1];
+				sortedParticles[position] = particle;
+			}
+			for (uint32_t k = bucketStarts[b]; k < bucketStarts[b + 1]; ++k)
+				sortedPositions[k] = particles.getPosition(sortedParticles[k]);
+		}
+	});
+}
+
+void SelfCollision::solve(Particles& particles, float distance, const uint8_t* particleAwake, ThreadPool* pool)
+{
+	contactCount = 0;
+	if (!isInitialized() || particles.size() + 1 != neighbourOffsets.size() || !(distance > 0.f))
+		return;
+
+	const float inverseCellSize = 1.f / distance;
+	buildHash(particles, inverseCellSize, pool);
+
+	const float distanceSquared = distance * distance;
+	// Particles go in bucket order, so that the next particle mostly looks at the same rows of buckets
+	contactCount = (size_t)parallelSum(pool, particles.size(), [&](size_t begin, size_t end) {
+		size_t contacts = 0;
+		for (size_t sorted = begin; sorted < end; ++sorted)
+		{
+			corrections[sorted] = glm::vec3(0.f);
+			const uint32_t i = sortedParticles[sorted];
+			const float inverseMass = particles.inverseMass[i];
+			if (inverseMass == 0.f || (particleAwake && !particleAwake[i])) continue;
+
+			const glm::vec3 position = sortedPositions[sorted];
+			const int32_t cellX = (int32_t)std::floor(position.x * inverseCellSize);
+			const int32_t cellY = (int32_t)std::floor(position.y * inverseCellSize);
+			const int32_t cellZ = (int32_t)std::floor(position.z * inverseCellSize);
+			glm::vec3 correction(0.f);
+			uint32_t count = 0;
+
+			auto collide = [&](uint32_t sortedBegin, uint32_t sortedEnd) {
+				for (uint32_t k = sortedBegin; k < sortedEnd; ++k)
+				{
+					const glm::vec3 offset = position - sortedPositions[k];
+					const float lengthSquared = glm::dot(offset, offset);
+					if (lengthSquared >= distanceSquared || lengthSquared == 0.f) continue;
+
+					const uint32_t j = sortedParticles[k];
+					if (areNeighbours(i, j)) continue;
+
+					// This particle's share of the separation, by inverse mass
+					const float length = std::sqrt(lengthSquared);
+					const float share = inverseMass / (inverseMass + particles.inverseMass[j]);
+					correction += offset * ((distance - length) / length * share);
+					++count;
+				}
+			};
+
+			// Every row of three cells along x is three consecutive buckets. Rows that wrap around the end of the
+			// table or share buckets with another row are rare and go bucket by bucket, skipping buckets seen before.
+			// The test goes without early outs, as it almost always passes and branches would cost more than it does.
+			uint32_t rows[9];
+			bool separate = true;
+			for (int32_t row = 0; row < 9; ++row)
+			{
+				rows[row] = getBucket(cellX - 1, cellY + row % 3 - 1, cellZ + row / 3 - 1);
+				separate &= rows[row] + 3 <= bucketMask + 1;
+				for (int32_t other = 0; other < row; ++other)
+					separate &= ((rows[row] - rows[other] + 2) & bucketMask) >= 5;
+			}
+
+			if (separate)
+			{
+				for (uint32_t row : rows)
+					collide(bucketStarts[row], bucketStarts[row + 3]);
+			}
+			else
+			{
+				for (int32_t row = 0; row < 9; ++row)
+				{
+					for (uint32_t o = 0; o < 3; ++o)
+					{
+						const uint32_t bucket = (rows[row] + o) & bucketMask;
+						bool seen = false;
+						for (int32_t other = 0; other < row && !seen; ++other)
+							seen = ((bucket - rows[other]) & bucketMask) < 3;
+						if (!seen)
+							collide(bucketStarts[bucket], bucketStarts[bucket + 1]);
+					}
+				}
+			}
+
+			if (count > 0)
+			{
+				corrections[sorted] = correction / (float)count;
+				contacts += count;
+			}
+		}
+		return (double)contacts;
+	});
+
+	if (contactCount == 0)
+		return;
+	parallelFor(pool, particles.size(), [&](size_t begin, size_t end) {
+		for (size_t sorted = begin; sorted < end; ++sorted)
+		{
+			const uint32_t i = sortedParticles[sorted];
+			particles.x[i] += corrections[sorted].x;
+			particles.y[i] += corrections[sorted].y;
+			particles.z[i] += corrections[sorted].z;
+		}
+	});
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "Particles.h"
+#include "Springs.h"
+#include "ThreadPool.h"
+#include <glm/vec3.hpp>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+// Keeps particles that no spring connects at least a given distance apart, so that cloth folding onto itself does
+// not pass through. Particles are binned into a uniform spatial hash with cells as wide as that distance, rebuilt
+// every step with a parallel counting sort, and each particle is only tested against the particles hashed to the 27
+// cells around it. Cells next to each other along x hash to consecutive buckets, so those 27 cells are 9 contiguous
+// runs of the sorted particles.
+//
+// Corrections are gathered per particle from the positions before the pass, Jacobi style, so particles are updated
+// in parallel without atomics and the result does not depend on the thread count.
+class SelfCollision {
+public:
+	void initialize(const Springs& springs, const std::vector<uint32_t>& adjacencyOffsets, const std::vector<uint32_t>& adjacency);
+	bool isInitialized() const { return !neighbourOffsets.empty(); }
+
+	// Pushes particles closer than distance apart; asleep particles, with particleAwake[i] == 0, stay in place
+	void solve(Particles& particles, float distance, const uint8_t* particleAwake, ThreadPool* pool);
+
+	// Pairs closer than the distance in the last solve, each counted from both sides
+	size_t getContactCount() const { return contactCount; }
+
+private:
+	void buildHash(const Particles& particles, float inverseCellSize, ThreadPool* pool);
+	uint32_t getBucket(int32_t x, int32_t y, int32_t z) const;
+	bool areNeighbours(uint32_t a, uint32_t b) const;
+
+	// Particles each particle shares a spring with, sorted
+	std::vector<uint32_t> neighbourOffsets;
+	std::vector<uint32_t> neighbours;
+
+	// Bucket of every particle, where each bucket's particles start in the sorted order, and the particles and
+	// their positions in bucket order
+	uint32_t bucketMask = 0;
+	std::vector<uint32_t> particleBuckets;
+	std::vector<std::atomic<uint32_t>> bucketCounts;
+	std::vector<uint32_t> bucketStarts;
+	std::vector<uint32_t> blockSums;
+	std::vector<uint32_t> sortedParticles;
+	std::vector<glm::vec3> sortedPositions;
+
+	std::vector<glm::vec3> corrections;
+	size_t contactCount = 0;
+
+	static constexpr size_t prefixBlockSize = 4096;
+};
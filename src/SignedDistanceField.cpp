@@ -0,0 +1,301 @@
+#include "SignedDistanceField.h"
+#include "TriangleGeometry.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <unordered_map>
+#include <fstream>
+#include <limits>
+#include <cmath>
+
+namespace {
+
+uint64_t edgeKey(uint32_t a, uint32_t b)
+{
+	return (uint64_t)std::min(a, b) << 32 | std::max(a, b);
+}
+
+// FNV-1a
+void hashBytes(uint64_t& hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+}
+
+constexpr uint32_t fileMagic = 0x46445343;	// "CSDF"
+constexpr uint32_t fileVersion = 1;
+
+}
+
+void SignedDistanceField::build(const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& indices, float _cellSize, float _bandWidth)
+{
+	cellSize = _cellSize;
+	bandWidth = _bandWidth;
+	inputHash = hashInput(vertices, indices, cellSize, bandWidth);
+	const size_t triangleCount = indices.size() / 3;
+
+	// Angle-weighted vertex normals, edge normals as the sum of the two adjacent face normals, and face normals
+	std::vector<glm::vec3> faceNormals(triangleCount);
+	std::vector<glm::vec3> vertexNormals(vertices.size(), glm::vec3(0.f));
+	std::unordered_map<uint64_t, glm::vec3> edgeNormals;
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		const uint32_t* corner = &indices[3 * t];
+		const glm::vec3 normal = glm::cross(vertices[corner[1]] - vertices[corner[0]], vertices[corner[2]] - vertices[corner[0]]);
+		const float area = glm::length(normal);
+		faceNormals[t] = area > 0.f ? normal / area : glm::vec3(0.f);
+		for (int k = 0; k < 3; ++k)
+		{
+			const glm::vec3 toNext = vertices[corner[(k + 1) % 3]] - vertices[corner[k]];
+			const glm::vec3 toPrevious = vertices[corner[(k + 2) % 3]] - vertices[corner[k]];
+			const float lengths = glm::length(toNext) * glm::length(toPrevious);
+			const float angle = lengths > 0.f ? std::acos(glm::clamp(glm::dot(toNext, toPrevious) / lengths, -1.f, 1.f)) : 0.f;
+			vertexNormals[corner[k]] += angle * faceNormals[t];
+			edgeNormals[edgeKey(corner[k], corner[(k + 1) % 3])] += faceNormals[t];
+		}
+	}
+
+	std::vector<glm::vec3> featureNormals(triangleCount * TriangleFeatureCount);
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		const uint32_t* corner = &indices[3 * t];
+		glm::vec3* normals = &featureNormals[t * TriangleFeatureCount];
+		for (int k = 0; k < 3; ++k)
+		{
+			normals[VertexA + k] = vertexNormals[corner[k]];
+			normals[EdgeAB + k] = edgeNormals[edgeKey(corner[k], corner[(k + 1) % 3])];
+		}
+		normals[Face] = faceNormals[t];
+	}
+
+	// Grid over the mesh bounds, padded by the band so that the surface is surrounded by stored bricks
+	glm::vec3 meshMin(std::numeric_limits<float>::max()), meshMax(-std::numeric_limits<float>::max());
+	for (const glm::vec3& vertex : vertices)
+	{
+		meshMin = glm::min(meshMin, vertex);
+		meshMax = glm::max(meshMax, vertex);
+	}
+	const float padding = bandWidth + cellSize;
+	origin = meshMin - glm::vec3(padding);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const float extent = meshMax[axis] - meshMin[axis] + 2.f * padding;
+		brickCounts[axis] = std::max<uint32_t>(1, (uint32_t)std::ceil(extent / (cellSize * brickSize)));
+	}
+
+	// Triangles that can come within the band of each brick
+	const size_t gridBrickCount = (size_t)brickCounts[0] * brickCounts[1] * brickCounts[2];
+	std::vector<std::vector<uint32_t>> brickTriangles(gridBrickCount);
+	const float brickLength = cellSize * brickSize;
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		const glm::vec3& a = vertices[indices[3 * t]];
+		const glm::vec3& b = vertices[indices[3 * t + 1]];
+		const glm::vec3& c = vertices[indices[3 * t + 2]];
+		const glm::vec3 lower = (glm::min(glm::min(a, b), c) - glm::vec3(bandWidth) - origin) / brickLength;
+		const glm::vec3 upper = (glm::max(glm::max(a, b), c) + glm::vec3(bandWidth) - origin) / brickLength;
+		uint32_t first[3], last[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			first[axis] = (uint32_t)std::max(0.f, std::floor(lower[axis]));
+			last[axis] = std::min(brickCounts[axis] - 1, (uint32_t)std::max(0.f, std::floor(upper[axis])));
+		}
+		for (uint32_t z = first[2]; z <= last[2]; ++z)
+		{
+			for (uint32_t y = first[1]; y <= last[1]; ++y)
+			{
+				for (uint32_t x = first[0]; x <= last[0]; ++x)
+					brickTriangles[((size_t)z * brickCounts[1] + y) * brickCounts[0] + x].push_back((uint32_t)t);
+			}
+		}
+	}
+
+	// Bricks whose samples all stay outside the band are dropped again
+	brickIndices.assign(gridBrickCount, noBrick);
+	samples.clear();
+	std::vector<float> brickSamples(samplesPerBrick);
+	for (size_t brick = 0; brick < gridBrickCount; ++brick)
+	{
+		if (brickTriangles[brick].empty()) continue;
+
+		const uint32_t brickX = (uint32_t)(brick % brickCounts[0]);
+		const uint32_t brickY = (uint32_t)(brick / brickCounts[0] % brickCounts[1]);
+		const uint32_t brickZ = (uint32_t)(brick / brickCounts[0] / brickCounts[1]);
+		const glm::vec3 brickOrigin = origin + glm::vec3((float)brickX, (float)brickY, (float)brickZ) * brickLength;
+		bool nearSurface = false;
+		for (uint32_t z = 0; z < brickEdge; ++z)
+		{
+			for (uint32_t y = 0; y < brickEdge; ++y)
+			{
+				for (uint32_t x = 0; x < brickEdge; ++x)
+				{
+					const glm::vec3 point = brickOrigin + glm::vec3((float)x, (float)y, (float)z) * cellSize;
+					// The sign is kept beyond the band, where the magnitude is clamped, so that no false surface
+					// appears between clamped and unclamped samples
+					float distanceSquared = std::numeric_limits<float>::infinity();
+					float sign = 1.f;
+					for (uint32_t t : brickTriangles[brick])
+					{
+						TriangleFeature feature;
+						const glm::vec3 closest = closestPointOnTriangle(point, vertices[indices[3 * t]], vertices[indices[3 * t + 1]], vertices[indices[3 * t + 2]], feature);
+						const float candidate = glm::dot(point - closest, point - closest);
+						if (candidate < distanceSquared)
+						{
+							distanceSquared = candidate;
+							sign = glm::dot(point - closest, featureNormals[t * TriangleFeatureCount + feature]) < 0.f ? -1.f : 1.f;
+						}
+					}
+					nearSurface = nearSurface || distanceSquared < bandWidth * bandWidth;
+					brickSamples[(z * brickEdge + y) * brickEdge + x] = sign * std::min(std::sqrt(distanceSquared), bandWidth);
+				}
+			}
+		}
+
+		if (!nearSurface) continue;
+		brickIndices[brick] = (uint32_t)getBrickCount();
+		samples.insert(samples.end(), brickSamples.begin(), brickSamples.end());
+	}
+}
+
+glm::vec3 SignedDistanceField::getBoundsMax() const
+{
+	return origin + glm::vec3((float)brickCounts[0], (float)brickCounts[1], (float)brickCounts[2]) * (cellSize * brickSize);
+}
+
+bool SignedDistanceField::sample(const glm::vec3& point, float& distance, glm::vec3& gradient) const
+{
+	const glm::vec3 grid = (point - origin) / cellSize;
+	uint32_t cell[3], brick[3];
+	float fraction[3];
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const uint32_t cellCount = brickCounts[axis] * brickSize;
+		if (!(grid[axis] >= 0.f && grid[axis] < (float)cellCount))
+			return false;
+		cell[axis] = std::min((uint32_t)grid[axis], cellCount - 1);
+		fraction[axis] = grid[axis] - (float)cell[axis];
+		brick[axis] = cell[axis] / brickSize;
+		cell[axis] -= brick[axis] * brickSize;
+	}
+
+	const uint32_t index = brickIndices[((size_t)brick[2] * brickCounts[1] + brick[1]) * brickCounts[0] + brick[0]];
+	if (index == noBrick)
+		return false;
+
+	const float* s = samples.data() + (size_t)index * samplesPerBrick + (cell[2] * brickEdge + cell[1]) * brickEdge + cell[0];
+	const float s000 = s[0], s100 = s[1];
+	const float s010 = s[brickEdge], s110 = s[brickEdge + 1];
+	const float s001 = s[brickEdge * brickEdge], s101 = s[brickEdge * brickEdge + 1];
+	const float s011 = s[brickEdge * brickEdge + brickEdge], s111 = s[brickEdge * brickEdge + brickEdge + 1];
+	const float fx = fraction[0], fy = fraction[1], fz = fraction[2];
+
+	const float x00 = s000 + (s100 - s000) * fx, x10 = s010 + (s110 - s010) * fx;
+	const float x01 = s001 + (s101 - s001) * fx, x11 = s011 + (s111 - s011) * fx;
+	const float y0 = x00 + (x10 - x00) * fy, y1 = x01 + (x11 - x01) * fy;
+	distance = y0 + (y1 - y0) * fz;
+
+	gradient.x = ((s100 - s000) * (1.f - fy) * (1.f - fz) + (s110 - s010) * fy * (1.f - fz) + (s101 - s001) * (1.f - fy) * fz + (s111 - s011) * fy * fz) / cellSize;
+	gradient.y = ((x10 - x00) * (1.f - fz) + (x11 - x01) * fz) / cellSize;
+	gradient.z = (y1 - y0) / cellSize;
+	return true;
+}
+
+uint64_t SignedDistanceField::hashInput(const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& indices, float cellSize, float bandWidth)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (const glm::vec3& vertex : vertices)
+		hashBytes(hash, &vertex.x, 3 * sizeof(float));
+	hashBytes(hash, indices.data(), indices.size() * sizeof(uint32_t));
+	hashBytes(hash, &cellSize, sizeof(cellSize));
+	hashBytes(hash, &bandWidth, sizeof(bandWidth));
+	return hash;
+}
+
+bool SignedDistanceField::save(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	const uint32_t brickCount = (uint32_t)getBrickCount();
+	file.write(reinterpret_cast<const char*>(&fileMagic), sizeof(fileMagic));
+	file.write(reinterpret_cast<const char*>(&fileVersion), sizeof(fileVersion));
+	file.write(reinterpret_cast<const char*>(&inputHash), sizeof(inputHash));
+	file.write(reinterpret_cast<const char*>(&origin.x), 3 * sizeof(float));
+	file.write(reinterpret_cast<const char*>(&cellSize), sizeof(cellSize));
+	file.write(reinterpret_cast<const char*>(&bandWidth), sizeof(bandWidth));
+	file.write(reinterpret_cast<const char*>(brickCounts), sizeof(brickCounts));
+	file.write(reinterpret_cast<const char*>(&brickCount), sizeof(brickCount));
+	file.write(reinterpret_cast<const char*>(brickIndices.data()), brickIndices.size() * sizeof(uint32_t));
+	file.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(float));
+	return (bool)file;
+}
+
+bool SignedDistanceField::load(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	uint32_t magic = 0, version = 0, brickCount = 0;
+	SignedDistanceField field;
+	file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+	file.read(reinterpret_cast<char*>(&version), sizeof(version));
+	if (!file || magic != fileMagic || version != fileVersion)
+		return false;
+
+	file.read(reinterpret_cast<char*>(&field.inputHash), sizeof(field.inputHash));
+	file.read(reinterpret_cast<char*>(&field.origin.x), 3 * sizeof(float));
+	file.read(reinterpret_cast<char*>(&field.cellSize), sizeof(field.cellSize));
+	file.read(reinterpret_cast<char*>(&field.bandWidth), sizeof(field.bandWidth));
+	file.read(reinterpret_cast<char*>(field.brickCounts), sizeof(field.brickCounts));
+	file.read(reinterpret_cast<char*>(&brickCount), sizeof(brickCount));
+	if (!file || !(field.cellSize > 0.f))
+		return false;
+
+	// The counts of a truncated or corrupt file must not reach the allocations: the grid and the samples have to fill
+	// exactly the rest of the file. Every factor is checked against the remaining size before it can overflow.
+	const std::streamoff headerEnd = file.tellg();
+	file.seekg(0, std::ios::end);
+	const uint64_t remaining = (uint64_t)(file.tellg() - headerEnd);
+	file.seekg(headerEnd);
+	uint64_t cellCount = 1;
+	for (uint32_t count : field.brickCounts)
+	{
+		if (count > 0 && cellCount > remaining / sizeof(uint32_t) / count)
+			return false;
+		cellCount *= count;
+	}
+	if (!file || (uint64_t)brickCount > remaining / (samplesPerBrick * sizeof(float)) ||
+		cellCount * sizeof(uint32_t) + (uint64_t)brickCount * samplesPerBrick * sizeof(float) != remaining)
+		return false;
+
+	field.brickIndices.resize((size_t)cellCount);
+	field.samples.resize((size_t)brickCount * samplesPerBrick);
+	file.read(reinterpret_cast<char*>(field.brickIndices.data()), field.brickIndices.size() * sizeof(uint32_t));
+	file.read(reinterpret_cast<char*>(field.samples.data()), field.samples.size() * sizeof(float));
+	if (!file || file.peek() != std::ifstream::traits_type::eof())
+		return false;
+	for (uint32_t index : field.brickIndices)
+	{
+		if (index != noBrick && index >= brickCount)
+			return false;
+	}
+
+	*this = std::move(field);
+	return true;
+}
+
+bool SignedDistanceField::loadOrBuild(const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& indices, float _cellSize, float _bandWidth,
+	const std::string& cachePath)
+{
+	if (load(cachePath) && inputHash == hashInput(vertices, indices, _cellSize, _bandWidth))
+		return true;
+
+	build(vertices, indices, _cellSize, _bandWidth);
+	save(cachePath);
+	return false;
+}
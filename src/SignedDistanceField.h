@@ -0,0 +1,54 @@
+#pragma once
+#include <glm/vec3.hpp>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Signed distance to a closed, consistently wound triangle mesh, negative inside, sampled on a regular grid. Only
+// bricks of brickSize^3 cells that come within the band width of the surface are stored, each with its own border
+// samples so that a lookup touches a single brick. Signs come from the angle-weighted pseudonormals of the closest
+// mesh feature.
+//
+// Beyond the stored bricks the field only knows that the distance is at least the band width, on either side, so
+// particles that end up deeper inside than that are not pushed out.
+class SignedDistanceField {
+public:
+	void build(const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& indices, float cellSize, float bandWidth);
+	bool save(const std::string& path) const;
+	bool load(const std::string& path);
+
+	// Loads the field from the cache file if it was built from the same mesh and parameters, otherwise builds it and
+	// writes the cache. Returns true if the cache was used. A cache that cannot be written is ignored; the field is
+	// simply built again next time.
+	bool loadOrBuild(const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& indices, float cellSize, float bandWidth,
+		const std::string& cachePath);
+
+	// Trilinear distance and its gradient at a point of the mesh's space. False outside the stored bricks.
+	bool sample(const glm::vec3& point, float& distance, glm::vec3& gradient) const;
+
+	bool isBuilt() const { return cellSize > 0.f; }
+	const glm::vec3& getBoundsMin() const { return origin; }
+	glm::vec3 getBoundsMax() const;
+	size_t getBrickCount() const { return samples.size() / samplesPerBrick; }
+	float getCellSize() const { return cellSize; }
+	float getBandWidth() const { return bandWidth; }
+
+	static constexpr uint32_t brickSize = 8;
+	static constexpr uint32_t brickEdge = brickSize + 1;
+	static constexpr size_t samplesPerBrick = brickEdge * brickEdge * brickEdge;
+
+private:
+	static uint64_t hashInput(const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& indices, float cellSize, float bandWidth);
+
+	static constexpr uint32_t noBrick = UINT32_MAX;
+	uint64_t inputHash = 0;
+	glm::vec3 origin{ 0.f };
+	float cellSize = 0.f;
+	float bandWidth = 0.f;
+	uint32_t brickCounts[3] = { 0, 0, 0 };
+
+	// Brick of every brick cell of the grid, x fastest, and the samples of the stored bricks, x fastest
+	std::vector<uint32_t> brickIndices;
+	std::vector<float> samples;
+};
@@ -0,0 +1,203 @@
+#include "SparseCholesky.h"
+#include "GraphOrdering.h"
+#include <algorithm>
+#include <cmath>
+
+bool SparseCholesky::factorize(size_t _size, const std::vector<Entry>& entries)
+{
+	size = _size;
+	diagonalPositions.clear();
+
+	// Fill-reducing ordering from the off-diagonal pattern
+	Graph graph;
+	graph.offsets.assign(size + 1, 0);
+	for (const Entry& entry : entries)
+	{
+		if (entry.row == entry.column) continue;
+		++graph.offsets[entry.row + 1];
+		++graph.offsets[entry.column + 1];
+	}
+
+	for (size_t i = 0; i < size; ++i)
+		graph.offsets[i + 1] += graph.offsets[i];
+
+	std::vector<uint32_t> fill(graph.offsets.begin(), graph.offsets.end() - 1);
+	graph.neighbours.resize(graph.offsets.back());
+	for (const Entry& entry : entries)
+	{
+		if (entry.row == entry.column) continue;
+		graph.neighbours[fill[entry.row]++] = entry.column;
+		graph.neighbours[fill[entry.column]++] = entry.row;
+	}
+
+	permutation = computeNestedDissectionOrdering(graph);
+	std::vector<uint32_t> inversePermutation(size);
+	for (size_t k = 0; k < size; ++k)
+		inversePermutation[permutation[k]] = (uint32_t)k;
+
+	// Upper triangle of the permuted matrix by columns, with duplicates summed
+	std::vector<uint32_t> columnOffsets(size + 1, 0);
+	for (const Entry& entry : entries)
+		++columnOffsets[std::max(inversePermutation[entry.row], inversePermutation[entry.column]) + 1];
+
+	for (size_t i = 0; i < size; ++i)
+		columnOffsets[i + 1] += columnOffsets[i];
+
+	std::vector<std::pair<uint32_t, double>> columnEntries(entries.size());
+	fill.assign(columnOffsets.begin(), columnOffsets.end() - 1);
+	for (const Entry& entry : entries)
+	{
+		const uint32_t row = inversePermutation[entry.row];
+		const uint32_t column = inversePermutation[entry.column];
+		columnEntries[fill[std::max(row, column)]++] = { std::min(row, column), entry.value };
+	}
+
+	std::vector<uint32_t> rows;
+	std::vector<double> values;
+	rows.reserve(entries.size());
+	values.reserve(entries.size());
+	for (size_t k = 0; k < size; ++k)
+	{
+		std::sort(columnEntries.begin() + columnOffsets[k], columnEntries.begin() + columnOffsets[k + 1],
+			[](const std::pair<uint32_t, double>& a, const std::pair<uint32_t, double>& b) { return a.first < b.first; });
+		const uint32_t begin = (uint32_t)rows.size();
+		for (uint32_t p = columnOffsets[k]; p < columnOffsets[k + 1]; ++p)
+		{
+			if (rows.size() > begin && rows.back() == columnEntries[p].first)
+			{
+				values.back() += columnEntries[p].second;
+				continue;
+			}
+
+			rows.push_back(columnEntries[p].first);
+			values.push_back(columnEntries[p].second);
+		}
+
+		columnOffsets[k] = begin;
+	}
+	columnOffsets[size] = (uint32_t)rows.size();
+
+	// Elimination tree
+	constexpr uint32_t none = ~0u;
+	std::vector<uint32_t> parent(size, none), ancestor(size, none);
+	for (uint32_t k = 0; k < size; ++k)
+	{
+		for (uint32_t p = columnOffsets[k]; p < columnOffsets[k + 1]; ++p)
+		{
+			for (uint32_t i = rows[p]; i != none && i < k;)
+			{
+				const uint32_t next = ancestor[i];
+				ancestor[i] = k;
+				if (next == none) parent[i] = k;
+				i = next;
+			}
+		}
+	}
+
+	// The pattern of row k of L is the set of etree paths from the entries of column k up to k
+	std::vector<uint32_t> flags(size, none), stack(size), path(size);
+	auto reach = [&](uint32_t k) {
+		size_t top = size;
+		flags[k] = k;
+		for (uint32_t p = columnOffsets[k]; p < columnOffsets[k + 1]; ++p)
+		{
+			size_t length = 0;
+			for (uint32_t i = rows[p]; flags[i] != k; i = parent[i])
+			{
+				path[length++] = i;
+				flags[i] = k;
+			}
+
+			while (length > 0)
+				stack[--top] = path[--length];
+		}
+
+		return top;
+	};
+
+	std::vector<uint32_t> columnCounts(size, 1);
+	for (uint32_t k = 0; k < size; ++k)
+		for (size_t top = reach(k); top < size; ++top)
+			++columnCounts[stack[top]];
+
+	factorColumnOffsets.assign(size + 1, 0);
+	for (size_t k = 0; k < size; ++k)
+		factorColumnOffsets[k + 1] = factorColumnOffsets[k] + columnCounts[k];
+
+	factorRows.resize(factorColumnOffsets.back());
+	factorValues.resize(factorColumnOffsets.back());
+
+	// Up-looking numeric factorization, one row of L at a time. The diagonal entry is the first of every column.
+	std::fill(flags.begin(), flags.end(), none);
+	std::vector<uint32_t> next(factorColumnOffsets.begin(), factorColumnOffsets.end() - 1);
+	std::vector<double> row(size, 0.0);
+	for (uint32_t k = 0; k < size; ++k)
+	{
+		const size_t top = reach(k);
+		for (uint32_t p = columnOffsets[k]; p < columnOffsets[k + 1]; ++p)
+			row[rows[p]] = values[p];
+
+		double diagonal = row[k];
+		row[k] = 0.0;
+		for (size_t t = top; t < size; ++t)
+		{
+			const uint32_t i = stack[t];
+			const double value = row[i] / factorValues[factorColumnOffsets[i]];
+			row[i] = 0.0;
+			for (uint32_t p = factorColumnOffsets[i] + 1; p < next[i]; ++p)
+				row[factorRows[p]] -= factorValues[p] * value;
+
+			diagonal -= value * value;
+			factorRows[next[i]] = k;
+			factorValues[next[i]++] = value;
+		}
+
+		if (diagonal <= 0.0) return false;
+		factorRows[next[k]] = k;
+		factorValues[next[k]++] = std::sqrt(diagonal);
+	}
+
+	diagonalPositions.assign(factorColumnOffsets.begin(), factorColumnOffsets.end() - 1);
+	return true;
+}
+
+void SparseCholesky::solve(double* values, size_t columnCount, double* workspace) const
+{
+	for (size_t k = 0; k < size; ++k)
+		for (size_t c = 0; c < columnCount; ++c)
+			workspace[k * columnCount + c] = values[permutation[k] * columnCount + c];
+
+	for (size_t j = 0; j < size; ++j)
+	{
+		double* x = workspace + j * columnCount;
+		const double inverseDiagonal = 1.0 / factorValues[diagonalPositions[j]];
+		for (size_t c = 0; c < columnCount; ++c)
+			x[c] *= inverseDiagonal;
+
+		for (uint32_t p = diagonalPositions[j] + 1; p < factorColumnOffsets[j + 1]; ++p)
+		{
+			double* y = workspace + factorRows[p] * columnCount;
+			for (size_t c = 0; c < columnCount; ++c)
+				y[c] -= factorValues[p] * x[c];
+		}
+	}
+
+	for (size_t j = size; j-- > 0;)
+	{
+		double* x = workspace + j * columnCount;
+		for (uint32_t p = diagonalPositions[j] + 1; p < factorColumnOffsets[j + 1]; ++p)
+		{
+			const double* y = workspace + factorRows[p] * columnCount;
+			for (size_t c = 0; c < columnCount; ++c)
+				x[c] -= factorValues[p] * y[c];
+		}
+
+		const double inverseDiagonal = 1.0 / factorValues[diagonalPositions[j]];
+		for (size_t c = 0; c < columnCount; ++c)
+			x[c] *= inverseDiagonal;
+	}
+
+	for (size_t k = 0; k < size; ++k)
+		for (size_t c = 0; c < columnCount; ++c)
+			values[permutation[k] * columnCount + c] = workspace[k * columnCount + c];
+}
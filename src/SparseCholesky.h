@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Sparse Cholesky factorization P A P^T = L L^T of a symmetric positive definite matrix, with a
+// nested dissection ordering P. Factor once, then every solve is a forward and a back substitution.
+class SparseCholesky {
+public:
+	struct Entry {
+		uint32_t row, column;
+		double value;
+	};
+
+	// Entries describe one triangle of the matrix (either one), duplicates are summed.
+	// Returns false if the matrix turned out not to be positive definite.
+	bool factorize(size_t size, const std::vector<Entry>& entries);
+	bool isFactorized() const { return !diagonalPositions.empty(); }
+	size_t getFactorNonZeroCount() const { return factorRows.size(); }
+
+	// Solves A X = B in place for columnCount right-hand sides stored interleaved, i.e. values[row * columnCount + column].
+	// All columns share a single pass over the factor. The workspace has to hold getSize() * columnCount doubles.
+	void solve(double* values, size_t columnCount, double* workspace) const;
+	size_t getSize() const { return size; }
+
+private:
+	size_t size = 0;
+	std::vector<uint32_t> permutation;	// permutation[k] is the original row of permuted row k
+	std::vector<uint32_t> factorColumnOffsets;
+	std::vector<uint32_t> factorRows;
+	std::vector<double> factorValues;
+	std::vector<uint32_t> diagonalPositions;
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include "Entity.h"
+#include "Colliders.h"
 
 class Sphere : public Entity {
 public:
@@ -7,6 +8,7 @@ public:
 	~Sphere() override;
 	void draw() const override;
 	float getRadius() const { return radius * scaleVector.x; };
+	SphereCollider getCollider() const { return { translationVector, getRadius() }; }
 
 private:
 	void constructModel(size_t sectorCount, size_t stackCount);
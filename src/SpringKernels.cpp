@@ -0,0 +1,164 @@
+#include "SpringKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#if defined(CLOTHSIM_SIMD_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+void computeSpringForcesScalar(const SpringForceArgs& args, size_t begin, size_t end)
+{
+	for (size_t s = begin; s < end; ++s)
+	{
+		const uint32_t p1 = args.particle1[s];
+		const uint32_t p2 = args.particle2[s];
+		const float dx = args.x[p2] - args.x[p1];
+		const float dy = args.y[p2] - args.y[p1];
+		const float dz = args.z[p2] - args.z[p1];
+		const float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+		const float magnitude = args.stiffness * (length - args.restLength[s]) / length;
+		args.forceX[s] = magnitude * dx;
+		args.forceY[s] = magnitude * dy;
+		args.forceZ[s] = magnitude * dz;
+	}
+}
+
+#if defined(CLOTHSIM_SIMD_X86)
+static void cpuid(int leaf, int subleaf, unsigned int registers[4])
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuidex(info, leaf, subleaf);
+	for (int i = 0; i < 4; ++i) registers[i] = (unsigned int)info[i];
+#else
+	__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+static unsigned long long xgetbv()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+
+static SimdLevel detectSimdLevel()
+{
+	unsigned int registers[4];
+	cpuid(0, 0, registers);
+	const unsigned int maxLeaf = registers[0];
+	cpuid(1, 0, registers);
+	const bool sse2 = registers[3] & (1u << 26);
+	const bool fma = registers[2] & (1u << 12);
+	const bool osxsave = registers[2] & (1u << 27);
+	const bool avx = registers[2] & (1u << 28);
+	if (!sse2) return SimdLevel::Scalar;
+
+	// The OS has to save the YMM (and for AVX-512 the opmask and ZMM) state on context switches
+	const unsigned long long xcr0 = osxsave ? xgetbv() : 0;
+	const bool ymmState = (xcr0 & 0x6) == 0x6;
+	const bool zmmState = (xcr0 & 0xe6) == 0xe6;
+	if (maxLeaf < 7 || !avx || !ymmState) return SimdLevel::SSE2;
+
+	cpuid(7, 0, registers);
+	const bool avx2 = registers[1] & (1u << 5);
+	const bool avx512f = registers[1] & (1u << 16);
+	if (avx512f && zmmState) return SimdLevel::AVX512;
+	if (avx2 && fma) return SimdLevel::AVX2;
+	return SimdLevel::SSE2;
+}
+#else
+static SimdLevel detectSimdLevel()
+{
+	return SimdLevel::Scalar;
+}
+#endif
+
+SimdLevel getSupportedSimdLevel()
+{
+	static const SimdLevel level = detectSimdLevel();
+	return level;
+}
+
+SpringForceKernel getSpringForceKernel(SimdLevel level)
+{
+	level = std::min(level, getSupportedSimdLevel());
+	switch (level)
+	{
+#if defined(CLOTHSIM_SIMD_X86)
+		case SimdLevel::AVX512: return computeSpringForcesAVX512;
+		case SimdLevel::AVX2: return computeSpringForcesAVX2;
+		case SimdLevel::SSE2: return computeSpringForcesSSE2;
+#endif
+		default: return computeSpringForcesScalar;
+	}
+}
+
+const char* getSimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+		case SimdLevel::AVX512: return "AVX-512";
+		case SimdLevel::AVX2: return "AVX2";
+		case SimdLevel::SSE2: return "SSE2";
+		default: return "Scalar";
+	}
+}
+
+float verifySpringForceKernel(SimdLevel level, size_t springCount)
+{
+	const size_t particleCount = springCount / 4 + 2;
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<float> coordinate(-1.f, 1.f);
+	std::uniform_real_distribution<float> length(0.01f, 0.5f);
+	std::uniform_int_distribution<uint32_t> particle(0, (uint32_t)particleCount - 1);
+
+	std::vector<float> x(particleCount), y(particleCount), z(particleCount);
+	for (size_t i = 0; i < particleCount; ++i)
+	{
+		x[i] = coordinate(generator);
+		y[i] = coordinate(generator);
+		z[i] = coordinate(generator);
+	}
+
+	std::vector<uint32_t> particle1(springCount), particle2(springCount);
+	std::vector<float> restLength(springCount);
+	for (size_t s = 0; s < springCount; ++s)
+	{
+		particle1[s] = particle(generator);
+		do particle2[s] = particle(generator); while (particle2[s] == particle1[s]);
+		restLength[s] = length(generator);
+	}
+
+	std::vector<float> referenceX(springCount), referenceY(springCount), referenceZ(springCount);
+	const float stiffness = 100.f + 5900.f * length(generator);
+	SpringForceArgs args{ x.data(), y.data(), z.data(), particle1.data(), particle2.data(), stiffness, restLength.data(),
+		referenceX.data(), referenceY.data(), referenceZ.data() };
+	computeSpringForcesScalar(args, 0, springCount);
+
+	std::vector<float> forceX(springCount), forceY(springCount), forceZ(springCount);
+	args.forceX = forceX.data();
+	args.forceY = forceY.data();
+	args.forceZ = forceZ.data();
+	getSpringForceKernel(level)(args, 0, springCount);
+
+	float maxError = 0.f;
+	for (size_t s = 0; s < springCount; ++s)
+	{
+		maxError = std::max(maxError, std::abs(forceX[s] - referenceX[s]) / std::max(1.f, std::abs(referenceX[s])));
+		maxError = std::max(maxError, std::abs(forceY[s] - referenceY[s]) / std::max(1.f, std::abs(referenceY[s])));
+		maxError = std::max(maxError, std::abs(forceZ[s] - referenceZ[s]) / std::max(1.f, std::abs(referenceZ[s])));
+	}
+
+	return maxError;
+}
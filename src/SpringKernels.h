@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+enum class SimdLevel { Scalar, SSE2, AVX2, AVX512 };
+
+// Inputs and outputs of the spring force pass over one spring batch, all as structure-of-arrays pointers.
+// The stiffness is shared by the whole batch. Force written for spring s is the force acting on particle1[s];
+// particle2[s] receives the negated value.
+struct SpringForceArgs {
+	const float* x;
+	const float* y;
+	const float* z;
+	const uint32_t* particle1;
+	const uint32_t* particle2;
+	float stiffness;
+	const float* restLength;
+	float* forceX;
+	float* forceY;
+	float* forceZ;
+};
+
+using SpringForceKernel = void (*)(const SpringForceArgs& args, size_t begin, size_t end);
+
+void computeSpringForcesScalar(const SpringForceArgs& args, size_t begin, size_t end);
+void computeSpringForcesSSE2(const SpringForceArgs& args, size_t begin, size_t end);
+void computeSpringForcesAVX2(const SpringForceArgs& args, size_t begin, size_t end);
+void computeSpringForcesAVX512(const SpringForceArgs& args, size_t begin, size_t end);
+
+// Highest instruction set that is both compiled in and supported by the running CPU, detected once via cpuid
+SimdLevel getSupportedSimdLevel();
+SpringForceKernel getSpringForceKernel(SimdLevel level);
+const char* getSimdLevelName(SimdLevel level);
+
+// Runs the kernel for the given level on random springs and returns the largest relative deviation from the scalar reference
+float verifySpringForceKernel(SimdLevel level, size_t springCount);
@@ -0,0 +1,24 @@
+#include "SpringKernels.h"
+#include <immintrin.h>
+
+void computeSpringForcesAVX2(const SpringForceArgs& args, size_t begin, size_t end)
+{
+	const __m256 stiffness = _mm256_set1_ps(args.stiffness);
+	size_t s = begin;
+	for (; s + 8 <= end; s += 8)
+	{
+		const __m256i p1 = _mm256_loadu_si256((const __m256i*)(args.particle1 + s));
+		const __m256i p2 = _mm256_loadu_si256((const __m256i*)(args.particle2 + s));
+		const __m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(args.x, p2, 4), _mm256_i32gather_ps(args.x, p1, 4));
+		const __m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(args.y, p2, 4), _mm256_i32gather_ps(args.y, p1, 4));
+		const __m256 dz = _mm256_sub_ps(_mm256_i32gather_ps(args.z, p2, 4), _mm256_i32gather_ps(args.z, p1, 4));
+		const __m256 length = _mm256_sqrt_ps(_mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx))));
+		const __m256 stretch = _mm256_sub_ps(length, _mm256_loadu_ps(args.restLength + s));
+		const __m256 magnitude = _mm256_div_ps(_mm256_mul_ps(stiffness, stretch), length);
+		_mm256_storeu_ps(args.forceX + s, _mm256_mul_ps(magnitude, dx));
+		_mm256_storeu_ps(args.forceY + s, _mm256_mul_ps(magnitude, dy));
+		_mm256_storeu_ps(args.forceZ + s, _mm256_mul_ps(magnitude, dz));
+	}
+
+	computeSpringForcesScalar(args, s, end);
+}
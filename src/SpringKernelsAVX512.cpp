@@ -0,0 +1,24 @@
+#include "SpringKernels.h"
+#include <immintrin.h>
+
+void computeSpringForcesAVX512(const SpringForceArgs& args, size_t begin, size_t end)
+{
+	const __m512 stiffness = _mm512_set1_ps(args.stiffness);
+	size_t s = begin;
+	for (; s + 16 <= end; s += 16)
+	{
+		const __m512i p1 = _mm512_loadu_si512(args.particle1 + s);
+		const __m512i p2 = _mm512_loadu_si512(args.particle2 + s);
+		const __m512 dx = _mm512_sub_ps(_mm512_i32gather_ps(p2, args.x, 4), _mm512_i32gather_ps(p1, args.x, 4));
+		const __m512 dy = _mm512_sub_ps(_mm512_i32gather_ps(p2, args.y, 4), _mm512_i32gather_ps(p1, args.y, 4));
+		const __m512 dz = _mm512_sub_ps(_mm512_i32gather_ps(p2, args.z, 4), _mm512_i32gather_ps(p1, args.z, 4));
+		const __m512 length = _mm512_sqrt_ps(_mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx))));
+		const __m512 stretch = _mm512_sub_ps(length, _mm512_loadu_ps(args.restLength + s));
+		const __m512 magnitude = _mm512_div_ps(_mm512_mul_ps(stiffness, stretch), length);
+		_mm512_storeu_ps(args.forceX + s, _mm512_mul_ps(magnitude, dx));
+		_mm512_storeu_ps(args.forceY + s, _mm512_mul_ps(magnitude, dy));
+		_mm512_storeu_ps(args.forceZ + s, _mm512_mul_ps(magnitude, dz));
+	}
+
+	computeSpringForcesScalar(args, s, end);
+}
@@ -0,0 +1,28 @@
+#include "SpringKernels.h"
+#include <emmintrin.h>
+
+// SSE2 has no gather instruction, so the endpoints of 4 springs are loaded lane by lane
+void computeSpringForcesSSE2(const SpringForceArgs& args, size_t begin, size_t end)
+{
+	const __m128 stiffness = _mm_set1_ps(args.stiffness);
+	size_t s = begin;
+	for (; s + 4 <= end; s += 4)
+	{
+		const uint32_t* p1 = args.particle1 + s;
+		const uint32_t* p2 = args.particle2 + s;
+		const __m128 dx = _mm_sub_ps(_mm_setr_ps(args.x[p2[0]], args.x[p2[1]], args.x[p2[2]], args.x[p2[3]]),
+			_mm_setr_ps(args.x[p1[0]], args.x[p1[1]], args.x[p1[2]], args.x[p1[3]]));
+		const __m128 dy = _mm_sub_ps(_mm_setr_ps(args.y[p2[0]], args.y[p2[1]], args.y[p2[2]], args.y[p2[3]]),
+			_mm_setr_ps(args.y[p1[0]], args.y[p1[1]], args.y[p1[2]], args.y[p1[3]]));
+		const __m128 dz = _mm_sub_ps(_mm_setr_ps(args.z[p2[0]], args.z[p2[1]], args.z[p2[2]], args.z[p2[3]]),
+			_mm_setr_ps(args.z[p1[0]], args.z[p1[1]], args.z[p1[2]], args.z[p1[3]]));
+		const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+		const __m128 stretch = _mm_sub_ps(length, _mm_loadu_ps(args.restLength + s));
+		const __m128 magnitude = _mm_div_ps(_mm_mul_ps(stiffness, stretch), length);
+		_mm_storeu_ps(args.forceX + s, _mm_mul_ps(magnitude, dx));
+		_mm_storeu_ps(args.forceY + s, _mm_mul_ps(magnitude, dy));
+		_mm_storeu_ps(args.forceZ + s, _mm_mul_ps(magnitude, dz));
+	}
+
+	computeSpringForcesScalar(args, s, end);
+}
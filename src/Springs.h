@@ -0,0 +1,101 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+// Structure-of-arrays spring storage. Particle indices are 32-bit so the SIMD kernels can gather with them directly.
+// Springs are stored in one contiguous batch per type and every batch has a single stiffness, so passes over a
+// batch keep it loop invariant and each spring only costs its two indices and its rest length. Passes in any other
+// order read the per-spring copy of the stiffness instead of searching for the batch.
+struct Springs {
+	// Springs are collected per type first; buildBatches lays them out batch after batch
+	void add(uint32_t p1, uint32_t p2, uint8_t springType)
+	{
+		if (springType >= pending.size())
+			pending.resize(springType + 1);
+		pending[springType].push_back(p1);
+		pending[springType].push_back(p2);
+	}
+
+	void buildBatches(const float* typeStiffness)
+	{
+		size_t count = 0;
+		for (const std::vector<uint32_t>& endpoints : pending)
+			count += endpoints.size() / 2;
+
+		particle1.clear();
+		particle2.clear();
+		particle1.reserve(count);
+		particle2.reserve(count);
+		batchOffsets.assign(1, 0);
+		batchStiffness.clear();
+		for (size_t type = 0; type < pending.size(); ++type)
+		{
+			for (size_t e = 0; e < pending[type].size(); e += 2)
+			{
+				particle1.push_back(pending[type][e]);
+				particle2.push_back(pending[type][e + 1]);
+			}
+			batchOffsets.push_back((uint32_t)particle1.size());
+			batchStiffness.push_back(typeStiffness[type]);
+		}
+
+		stiffness.resize(count);
+		for (size_t batch = 0; batch < getBatchCount(); ++batch)
+			std::fill(stiffness.begin() + getBatchBegin(batch), stiffness.begin() + getBatchEnd(batch), batchStiffness[batch]);
+
+		restLength.assign(count, 0.f);
+		pending.clear();
+		pending.shrink_to_fit();
+	}
+
+	// Renames every endpoint p to slot[p] and sorts each batch by its lower endpoint, so a pass over a batch walks
+	// the particles in memory order. Rest lengths have to be recomputed afterwards.
+	void remapParticles(const std::vector<uint32_t>& slot)
+	{
+		std::vector<uint64_t> keys;
+		for (size_t batch = 0; batch < getBatchCount(); ++batch)
+		{
+			keys.clear();
+			for (size_t s = getBatchBegin(batch); s < getBatchEnd(batch); ++s)
+			{
+				const uint64_t p1 = slot[particle1[s]], p2 = slot[particle2[s]];
+				keys.push_back(std::min(p1, p2) << 32 | std::max(p1, p2));
+			}
+
+			std::sort(keys.begin(), keys.end());
+			for (size_t k = 0; k < keys.size(); ++k)
+			{
+				particle1[getBatchBegin(batch) + k] = (uint32_t)(keys[k] >> 32);
+				particle2[getBatchBegin(batch) + k] = (uint32_t)keys[k];
+			}
+		}
+	}
+
+	size_t size() const { return particle1.size(); }
+	size_t getBatchCount() const { return batchStiffness.size(); }
+	uint32_t getBatchBegin(size_t batch) const { return batchOffsets[batch]; }
+	uint32_t getBatchEnd(size_t batch) const { return batchOffsets[batch + 1]; }
+	float getBatchStiffness(size_t batch) const { return batchStiffness[batch]; }
+
+	// Batch of a single spring, a search over the batches for code outside the passes
+	size_t getBatch(size_t spring) const
+	{
+		size_t batch = 0;
+		while (spring >= batchOffsets[batch + 1]) ++batch;
+		return batch;
+	}
+
+	std::vector<uint32_t> particle1, particle2;
+	std::vector<float> restLength;
+
+	// The stiffness of each spring's batch, for passes that reach springs through the particle adjacency or a
+	// coloring instead of batch by batch
+	std::vector<float> stiffness;
+
+private:
+	std::vector<uint32_t> batchOffsets;
+	std::vector<float> batchStiffness;
+	std::vector<std::vector<uint32_t>> pending;
+};
@@ -0,0 +1,112 @@
+#include "StencilKernels.h"
+#include <cmath>
+#include <cstddef>
+
+template <class Stencil>
+static void accumulateChecked(const StencilForceArgs& args, size_t width, size_t row, size_t column)
+{
+	const size_t i = row * width + column;
+	float fx = 0.f, fy = 0.f, fz = 0.f;
+	for (size_t o = 0; o < Stencil::count; ++o)
+	{
+		const ptrdiff_t neighbourRow = (ptrdiff_t)row + Stencil::offsets[o].row;
+		const ptrdiff_t neighbourColumn = (ptrdiff_t)column + Stencil::offsets[o].column;
+		if (neighbourRow < 0 || neighbourRow >= (ptrdiff_t)args.height || neighbourColumn < 0 || neighbourColumn >= (ptrdiff_t)width)
+			continue;
+
+		const size_t n = (size_t)neighbourRow * width + (size_t)neighbourColumn;
+		const float dx = args.x[n] - args.x[i];
+		const float dy = args.y[n] - args.y[i];
+		const float dz = args.z[n] - args.z[i];
+		const float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+		const float magnitude = args.stiffness[o] * (length - args.restLength[o]) / length;
+		fx += magnitude * dx;
+		fy += magnitude * dy;
+		fz += magnitude * dz;
+	}
+
+	args.forceX[i] = fx;
+	args.forceY[i] = fy;
+	args.forceZ[i] = fz;
+}
+
+// Adds the force of one stencil direction to a run of particles. Positions and forces never overlap;
+// saying so lets the compiler vectorize the loop without alias checks.
+static void accumulateSweep(const float* __restrict x, const float* __restrict y, const float* __restrict z,
+	const float* __restrict neighbourX, const float* __restrict neighbourY, const float* __restrict neighbourZ,
+	float* __restrict forceX, float* __restrict forceY, float* __restrict forceZ, float stiffness, float restLength, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float dx = neighbourX[i] - x[i];
+		const float dy = neighbourY[i] - y[i];
+		const float dz = neighbourZ[i] - z[i];
+		const float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+		const float magnitude = stiffness * (length - restLength) / length;
+		forceX[i] += magnitude * dx;
+		forceY[i] += magnitude * dy;
+		forceZ[i] += magnitude * dz;
+	}
+}
+
+template <class Stencil, size_t Width>
+void computeStencilForces(const StencilForceArgs& args, size_t beginRow, size_t endRow)
+{
+	const size_t width = Width != 0 ? Width : args.width;
+	constexpr size_t reach = Stencil::reach;
+	for (size_t row = beginRow; row < endRow; ++row)
+	{
+		const bool interiorRow = row >= reach && row + reach < args.height && width > 2 * reach;
+		if (!interiorRow)
+		{
+			for (size_t column = 0; column < width; ++column)
+				accumulateChecked<Stencil>(args, width, row, column);
+			continue;
+		}
+
+		for (size_t column = 0; column < reach; ++column)
+		{
+			accumulateChecked<Stencil>(args, width, row, column);
+			accumulateChecked<Stencil>(args, width, row, width - 1 - column);
+		}
+
+		// Interior: one unit-stride sweep over the row per stencil offset
+		const size_t rowBegin = row * width + reach;
+		const size_t rowEnd = row * width + width - reach;
+		for (size_t i = rowBegin; i < rowEnd; ++i)
+			args.forceX[i] = args.forceY[i] = args.forceZ[i] = 0.f;
+
+		for (size_t o = 0; o < Stencil::count; ++o)
+		{
+			const ptrdiff_t offset = (ptrdiff_t)Stencil::offsets[o].row * (ptrdiff_t)width + Stencil::offsets[o].column;
+			accumulateSweep(args.x + rowBegin, args.y + rowBegin, args.z + rowBegin,
+				args.x + rowBegin + offset, args.y + rowBegin + offset, args.z + rowBegin + offset,
+				args.forceX + rowBegin, args.forceY + rowBegin, args.forceZ + rowBegin,
+				args.stiffness[o], args.restLength[o], rowEnd - rowBegin);
+		}
+	}
+}
+
+template <class Stencil>
+static StencilForceKernel getSpecializedKernel(size_t width)
+{
+	switch (width)
+	{
+		case 32: return computeStencilForces<Stencil, 32>;
+		case 50: return computeStencilForces<Stencil, 50>;
+		case 64: return computeStencilForces<Stencil, 64>;
+		case 128: return computeStencilForces<Stencil, 128>;
+		case 256: return computeStencilForces<Stencil, 256>;
+		default: return computeStencilForces<Stencil, 0>;
+	}
+}
+
+StencilForceKernel getStencilForceKernel(size_t width, StencilShape shape)
+{
+	switch (shape)
+	{
+		case StencilShape::StructuralShear: return getSpecializedKernel<StructuralShearStencil>(width);
+		case StencilShape::Bending: return getSpecializedKernel<BendingStencil>(width);
+		default: return getSpecializedKernel<ClothStencil>(width);
+	}
+}
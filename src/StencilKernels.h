@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Neighbour direction of a grid stencil, in rows and columns, with the spring type it stands for
+struct StencilOffset {
+	int row;
+	int column;
+	uint8_t type;
+};
+
+// Structural, shear and bending neighbours of a cloth grid, both directions of every spring listed
+struct ClothStencil {
+	static constexpr size_t count = 12;
+	static constexpr int reach = 2;
+	static constexpr StencilOffset offsets[count] = {
+		{ 0, -1, 0 }, { 0, 1, 0 }, { -1, 0, 0 }, { 1, 0, 0 },
+		{ -1, -1, 1 }, { -1, 1, 1 }, { 1, -1, 1 }, { 1, 1, 1 },
+		{ 0, -2, 2 }, { 0, 2, 2 }, { -2, 0, 2 }, { 2, 0, 2 }
+	};
+};
+
+// Stiff part of the cloth stencil: its first 8 offsets, the structural and shear neighbours
+struct StructuralShearStencil {
+	static constexpr size_t count = 8;
+	static constexpr int reach = 1;
+	static constexpr const StencilOffset* offsets = ClothStencil::offsets;
+};
+
+// Soft part of the cloth stencil: its last 4 offsets, the bending neighbours
+struct BendingStencil {
+	static constexpr size_t count = 4;
+	static constexpr int reach = 2;
+	static constexpr const StencilOffset* offsets = ClothStencil::offsets + StructuralShearStencil::count;
+};
+
+enum class StencilShape { Cloth, StructuralShear, Bending };
+
+// Inputs and outputs of the stencil force pass over a row-major width x height particle grid.
+// Stiffness and rest length are given per stencil offset; the kernel writes the total spring force of each particle.
+struct StencilForceArgs {
+	const float* x;
+	const float* y;
+	const float* z;
+	const float* stiffness;
+	const float* restLength;
+	float* forceX;
+	float* forceY;
+	float* forceZ;
+	size_t width;
+	size_t height;
+};
+
+using StencilForceKernel = void (*)(const StencilForceArgs& args, size_t beginRow, size_t endRow);
+
+// Stencil shape and row width are template parameters, so neighbour offsets become constants and interior rows
+// run without bounds checks. Width 0 reads the width from the arguments.
+template <class Stencil, size_t Width>
+void computeStencilForces(const StencilForceArgs& args, size_t beginRow, size_t endRow);
+
+// Kernel for the stencil shape, specialized for the given width when it is a common one, generic otherwise.
+// Stiffness and rest length arrays are indexed by the offsets of the chosen shape.
+StencilForceKernel getStencilForceKernel(size_t width, StencilShape shape = StencilShape::Cloth);
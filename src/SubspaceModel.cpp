@@ -0,0 +1,580 @@
+#include "SubspaceModel.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <cmath>
+
+namespace {
+
+// Cyclic Jacobi eigen decomposition of a symmetric n x n row-major matrix, which is destroyed. The eigenvectors
+// end up in the columns of vectors.
+void computeSymmetricEigen(std::vector<double>& matrix, size_t n, std::vector<double>& values, std::vector<double>& vectors)
+{
+	vectors.assign(n * n, 0.0);
+	for (size_t i = 0; i < n; ++i)
+		vectors[i * n + i] = 1.0;
+
+	for (int sweep = 0; sweep < 50; ++sweep)
+	{
+		double offDiagonal = 0.0, diagonal = 0.0;
+		for (size_t p = 0; p < n; ++p)
+		{
+			diagonal += matrix[p * n + p] * matrix[p * n + p];
+			for (size_t q = p + 1; q < n; ++q)
+				offDiagonal += matrix[p * n + q] * matrix[p * n + q];
+		}
+		if (offDiagonal <= 1e-24 * diagonal)
+			break;
+
+		for (size_t p = 0; p < n; ++p)
+		{
+			for (size_t q = p + 1; q < n; ++q)
+			{
+				const double apq = matrix[p * n + q];
+				if (apq == 0.0) continue;
+
+				const double theta = (matrix[q * n + q] - matrix[p * n + p]) / (2.0 * apq);
+				const double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+				const double c = 1.0 / std::sqrt(t * t + 1.0);
+				const double s = t * c;
+				for (size_t k = 0; k < n; ++k)
+				{
+					const double akp = matrix[k * n + p], akq = matrix[k * n + q];
+					matrix[k * n + p] = c * akp - s * akq;
+					matrix[k * n + q] = s * akp + c * akq;
+				}
+				for (size_t k = 0; k < n; ++k)
+				{
+					const double apk = matrix[p * n + k], aqk = matrix[q * n + k];
+					matrix[p * n + k] = c * apk - s * aqk;
+					matrix[q * n + k] = s * apk + c * aqk;
+				}
+				for (size_t k = 0; k < n; ++k)
+				{
+					const double vkp = vectors[k * n + p], vkq = vectors[k * n + q];
+					vectors[k * n + p] = c * vkp - s * vkq;
+					vectors[k * n + q] = s * vkp + c * vkq;
+				}
+			}
+		}
+	}
+
+	values.resize(n);
+	for (size_t i = 0; i < n; ++i)
+		values[i] = matrix[i * n + i];
+}
+
+// Solves the symmetric positive definite n x n row-major system in place of rhs. The matrix is overwritten by
+// its Cholesky factor; returns false if it is not positive definite.
+bool solveCholesky(double* matrix, size_t n, double* rhs)
+{
+	for (size_t j = 0; j < n; ++j)
+	{
+		double sum = matrix[j * n + j];
+		for (size_t k = 0; k < j; ++k)
+			sum -= matrix[j * n + k] * matrix[j * n + k];
+		if (!(sum > 0.0))
+			return false;
+
+		const double diagonal = std::sqrt(sum);
+		matrix[j * n + j] = diagonal;
+		for (size_t i = j + 1; i < n; ++i)
+		{
+			double value = matrix[i * n + j];
+			for (size_t k = 0; k < j; ++k)
+				value -= matrix[i * n + k] * matrix[j * n + k];
+			matrix[i * n + j] = value / diagonal;
+		}
+	}
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		for (size_t k = 0; k < i; ++k)
+			rhs[i] -= matrix[i * n + k] * rhs[k];
+		rhs[i] /= matrix[i * n + i];
+	}
+	for (size_t i = n; i-- > 0;)
+	{
+		for (size_t k = i + 1; k < n; ++k)
+			rhs[i] -= matrix[k * n + i] * rhs[k];
+		rhs[i] /= matrix[i * n + i];
+	}
+	return true;
+}
+
+// Lawson-Hanson non-negative least squares on the normal equations: minimizes |A w - b| over w >= 0 given A^T A
+// (n x n, row stride `stride`) and A^T b, warm started from the feasible w
+void solveNonNegativeLeastSquares(const std::vector<double>& normal, size_t stride, const std::vector<double>& normalRhs, size_t n, std::vector<double>& w)
+{
+	std::vector<char> passive(n);
+	for (size_t j = 0; j < n; ++j)
+		passive[j] = w[j] > 0.0;
+
+	const double tolerance = 1e-12 * std::max(1.0, *std::max_element(normalRhs.begin(), normalRhs.begin() + n, [](double a, double b) { return std::abs(a) < std::abs(b); }));
+	std::vector<double> z(n), system, rhs;
+	std::vector<size_t> indices;
+	for (size_t iteration = 0; iteration < 3 * n + 10; ++iteration)
+	{
+		// Least squares on the passive set, stepping back towards w until it is feasible
+		while (std::find(passive.begin(), passive.end(), 1) != passive.end())
+		{
+			indices.clear();
+			for (size_t j = 0; j < n; ++j)
+			{
+				if (passive[j])
+					indices.push_back(j);
+			}
+			system.resize(indices.size() * indices.size());
+			rhs.resize(indices.size());
+			for (size_t a = 0; a < indices.size(); ++a)
+			{
+				rhs[a] = normalRhs[indices[a]];
+				for (size_t b = 0; b < indices.size(); ++b)
+					system[a * indices.size() + b] = normal[indices[a] * stride + indices[b]];
+			}
+			if (!solveCholesky(system.data(), indices.size(), rhs.data()))
+				return;
+
+			std::fill(z.begin(), z.end(), 0.0);
+			for (size_t a = 0; a < indices.size(); ++a)
+				z[indices[a]] = rhs[a];
+
+			double alpha = 1.0;
+			for (size_t j : indices)
+			{
+				if (z[j] <= 0.0)
+					alpha = std::min(alpha, w[j] / (w[j] - z[j]));
+			}
+			for (size_t j = 0; j < n; ++j)
+				w[j] += alpha * (z[j] - w[j]);
+			if (alpha == 1.0)
+				break;
+			for (size_t j : indices)
+			{
+				if (w[j] <= 0.0)
+				{
+					w[j] = 0.0;
+					passive[j] = 0;
+				}
+			}
+		}
+
+		// The active element whose weight would reduce the error most joins the passive set
+		size_t best = n;
+		double bestGradient = tolerance;
+		for (size_t j = 0; j < n; ++j)
+		{
+			if (passive[j]) continue;
+			double gradient = normalRhs[j];
+			for (size_t k = 0; k < n; ++k)
+				gradient -= normal[j * stride + k] * w[k];
+			if (gradient > bestGradient)
+			{
+				bestGradient = gradient;
+				best = j;
+			}
+		}
+		if (best == n)
+			return;
+		passive[best] = 1;
+	}
+}
+
+double dot(const std::vector<double>& a, const std::vector<double>& b)
+{
+	return std::inner_product(a.begin(), a.end(), b.begin(), 0.0);
+}
+
+}
+
+void SubspaceModel::build(const Description& cloth, const std::vector<Snapshot>& snapshots, size_t _modeCount, size_t cubatureSize)
+{
+	restPositions = cloth.restPositions;
+	mass = cloth.mass;
+	airResistance = cloth.airResistance;
+	const size_t dofCount = 3 * restPositions.size();
+
+	mean.assign(dofCount, 0.0);
+	for (const Snapshot& snapshot : snapshots)
+	{
+		for (size_t p = 0; p < restPositions.size(); ++p)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+				mean[3 * p + axis] += snapshot.displacements[p][axis] / snapshots.size();
+		}
+	}
+
+	// Method of snapshots: the eigenvectors of the small Gram matrix of the centered snapshots give the principal
+	// displacement modes
+	const size_t stride = (snapshots.size() + maxBasisSnapshots - 1) / maxBasisSnapshots;
+	std::vector<std::vector<double>> centered;
+	for (size_t t = 0; t < snapshots.size(); t += stride)
+	{
+		std::vector<double> displacement(dofCount);
+		for (size_t p = 0; p < restPositions.size(); ++p)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+				displacement[3 * p + axis] = snapshots[t].displacements[p][axis] - mean[3 * p + axis];
+		}
+		centered.push_back(std::move(displacement));
+	}
+
+	const size_t sampleCount = centered.size();
+	std::vector<double> gram(sampleCount * sampleCount);
+	for (size_t a = 0; a < sampleCount; ++a)
+	{
+		for (size_t b = a; b < sampleCount; ++b)
+			gram[a * sampleCount + b] = gram[b * sampleCount + a] = dot(centered[a], centered[b]);
+	}
+
+	std::vector<double> values, vectors;
+	computeSymmetricEigen(gram, sampleCount, values, vectors);
+	std::vector<size_t> order(sampleCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return values[a] > values[b]; });
+
+	modeCount = 0;
+	while (modeCount < std::min(_modeCount, sampleCount) && values[order[modeCount]] > 1e-10 * values[order[0]])
+		++modeCount;
+
+	basis.assign(dofCount * modeCount, 0.0);
+	for (size_t k = 0; k < modeCount; ++k)
+	{
+		const double scale = 1.0 / std::sqrt(values[order[k]]);
+		for (size_t t = 0; t < sampleCount; ++t)
+		{
+			const double coefficient = vectors[t * sampleCount + order[k]] * scale;
+			for (size_t d = 0; d < dofCount; ++d)
+				basis[d * modeCount + k] += coefficient * centered[t][d];
+		}
+	}
+
+	reducedGravity.assign(modeCount, 0.0);
+	for (size_t p = 0; p < restPositions.size(); ++p)
+	{
+		const double* rows = getBasis(p);
+		for (size_t k = 0; k < modeCount; ++k)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+				reducedGravity[k] += rows[axis * modeCount + k] * mass * cloth.gravity[axis];
+		}
+	}
+
+	fitCubature(cloth, snapshots, cubatureSize);
+}
+
+void SubspaceModel::fitCubature(const Description& cloth, const std::vector<Snapshot>& snapshots, size_t cubatureSize)
+{
+	// Training poses: evenly spaced snapshots, projected into the subspace so the cubature sees reachable states
+	const size_t stride = (snapshots.size() + maxCubaturePoses - 1) / maxCubaturePoses;
+	std::vector<std::vector<glm::vec3>> positions, velocities;
+	std::vector<float> times;
+	State state;
+	for (size_t t = 0; t < snapshots.size(); t += stride)
+	{
+		project(snapshots[t].displacements, snapshots[t].velocities, state);
+		positions.emplace_back(restPositions.size());
+		velocities.emplace_back(restPositions.size());
+		for (size_t p = 0; p < restPositions.size(); ++p)
+			reconstructParticle(state, (uint32_t)p, positions.back()[p], velocities.back()[p]);
+		times.push_back(snapshots[t].time);
+	}
+
+	// Elements are the springs followed by the free particles, which carry the wind and the air resistance
+	std::vector<uint32_t> freeParticles;
+	for (size_t p = 0; p < restPositions.size(); ++p)
+	{
+		if (cloth.inverseMass[p] != 0.f)
+			freeParticles.push_back((uint32_t)p);
+	}
+
+	const size_t springCount = cloth.springs.size();
+	const size_t elementCount = springCount + freeParticles.size();
+	const size_t rowCount = positions.size() * modeCount;
+	auto computeColumn = [&](size_t element, std::vector<double>& column) {
+		column.resize(rowCount);
+		for (size_t pose = 0; pose < positions.size(); ++pose)
+		{
+			double* reduced = column.data() + pose * modeCount;
+			if (element < springCount)
+			{
+				const Spring& spring = cloth.springs[element];
+				const glm::vec3 delta = positions[pose][spring.particle2] - positions[pose][spring.particle1];
+				const float length = glm::length(delta);
+				const glm::vec3 force = length > 0.f ? spring.stiffness * (length - spring.restLength) * (delta / length) : glm::vec3(0.f);
+				const double* rows1 = getBasis(spring.particle1);
+				const double* rows2 = getBasis(spring.particle2);
+				for (size_t k = 0; k < modeCount; ++k)
+				{
+					reduced[k] = 0.0;
+					for (int axis = 0; axis < 3; ++axis)
+						reduced[k] += (rows1[axis * modeCount + k] - rows2[axis * modeCount + k]) * force[axis];
+				}
+			}
+			else
+			{
+				const uint32_t particle = freeParticles[element - springCount];
+				const glm::vec3 velocity = velocities[pose][particle];
+				glm::vec3 force = -airResistance * velocity * glm::abs(velocity);
+				if (cloth.wind)
+					force += cloth.wind(positions[pose][particle], times[pose]);
+				const double* rows = getBasis(particle);
+				for (size_t k = 0; k < modeCount; ++k)
+					reduced[k] = rows[k] * force.x + rows[modeCount + k] * force.y + rows[2 * modeCount + k] * force.z;
+			}
+		}
+	};
+
+	std::vector<double> target(rowCount, 0.0), column;
+	for (size_t element = 0; element < elementCount; ++element)
+	{
+		computeColumn(element, column);
+		for (size_t row = 0; row < rowCount; ++row)
+			target[row] += column[row];
+	}
+
+	// Greedy selection: the candidate best aligned with the remaining error joins, then all weights are refitted
+	// without going negative
+	std::vector<std::vector<double>> columns;
+	std::vector<size_t> selected;
+	std::vector<double> weights;
+	std::vector<double> normal(cubatureSize * cubatureSize), normalRhs(cubatureSize);
+	std::vector<char> chosen(elementCount, 0);
+	std::vector<double> residual = target;
+	std::mt19937 engine(1);
+	const double targetNorm = std::sqrt(dot(target, target));
+	cubatureError = 1.0;
+	while (selected.size() < std::min(cubatureSize, elementCount) && targetNorm > 0.0)
+	{
+		size_t best = elementCount;
+		double bestScore = 0.0;
+		std::vector<double> bestColumn;
+		for (size_t c = 0; c < cubatureCandidates; ++c)
+		{
+			const size_t element = engine() % elementCount;
+			if (chosen[element]) continue;
+
+			computeColumn(element, column);
+			const double norm = std::sqrt(dot(column, column));
+			const double score = norm > 0.0 ? dot(column, residual) / norm : 0.0;
+			if (score > bestScore)
+			{
+				bestScore = score;
+				best = element;
+				bestColumn = column;
+			}
+		}
+		if (best == elementCount)
+			break;
+
+		const size_t k = selected.size();
+		chosen[best] = 1;
+		selected.push_back(best);
+		columns.push_back(std::move(bestColumn));
+		for (size_t i = 0; i <= k; ++i)
+			normal[i * cubatureSize + k] = normal[k * cubatureSize + i] = dot(columns[i], columns[k]);
+		normalRhs[k] = dot(columns[k], target);
+		weights.push_back(0.0);
+		solveNonNegativeLeastSquares(normal, cubatureSize, normalRhs, k + 1, weights);
+
+		residual = target;
+		for (size_t i = 0; i <= k; ++i)
+		{
+			for (size_t row = 0; row < rowCount; ++row)
+				residual[row] -= weights[i] * columns[i][row];
+		}
+		cubatureError = std::sqrt(dot(residual, residual)) / targetNorm;
+		if (cubatureError < 1e-4)
+			break;
+	}
+
+	// Elements that ended up with a weight, and the particles they read
+	cubatureSprings.clear();
+	cubatureParticles.clear();
+	supportParticles.clear();
+	std::vector<uint32_t> supportSlot(restPositions.size(), UINT32_MAX);
+	auto addSupport = [&](uint32_t particle) {
+		if (supportSlot[particle] == UINT32_MAX)
+		{
+			supportSlot[particle] = (uint32_t)supportParticles.size();
+			supportParticles.push_back(particle);
+		}
+		return supportSlot[particle];
+	};
+	for (size_t i = 0; i < selected.size(); ++i)
+	{
+		if (weights[i] <= 0.0) continue;
+		if (selected[i] < springCount)
+		{
+			const Spring& spring = cloth.springs[selected[i]];
+			cubatureSprings.push_back({ spring, addSupport(spring.particle1), addSupport(spring.particle2), weights[i] });
+		}
+		else
+		{
+			const uint32_t particle = freeParticles[selected[i] - springCount];
+			cubatureParticles.push_back({ particle, addSupport(particle), weights[i] });
+		}
+	}
+}
+
+void SubspaceModel::project(const std::vector<glm::vec3>& displacements, const std::vector<glm::vec3>& velocities, State& state) const
+{
+	state.coordinates.assign(modeCount, 0.0);
+	state.velocities.assign(modeCount, 0.0);
+	for (size_t p = 0; p < restPositions.size(); ++p)
+	{
+		const double* rows = getBasis(p);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const double displacement = displacements[p][axis] - mean[3 * p + axis];
+			const double velocity = velocities.empty() ? 0.0 : velocities[p][axis];
+			for (size_t k = 0; k < modeCount; ++k)
+			{
+				state.coordinates[k] += rows[axis * modeCount + k] * displacement;
+				state.velocities[k] += rows[axis * modeCount + k] * velocity;
+			}
+		}
+	}
+}
+
+void SubspaceModel::reconstruct(const State& state, std::vector<glm::vec3>& displacements, std::vector<glm::vec3>* velocities) const
+{
+	displacements.resize(restPositions.size());
+	if (velocities)
+		velocities->resize(restPositions.size());
+	for (size_t p = 0; p < restPositions.size(); ++p)
+	{
+		const double* rows = getBasis(p);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			double displacement = mean[3 * p + axis];
+			for (size_t k = 0; k < modeCount; ++k)
+				displacement += rows[axis * modeCount + k] * state.coordinates[k];
+			displacements[p][axis] = (float)displacement;
+		}
+
+		if (velocities)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				double velocity = 0.0;
+				for (size_t k = 0; k < modeCount; ++k)
+					velocity += rows[axis * modeCount + k] * state.velocities[k];
+				(*velocities)[p][axis] = (float)velocity;
+			}
+		}
+	}
+}
+
+void SubspaceModel::reconstructParticle(const State& state, uint32_t particle, glm::vec3& position, glm::vec3& velocity) const
+{
+	const double* rows = getBasis(particle);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		double displacement = mean[3 * particle + axis], speed = 0.0;
+		for (size_t k = 0; k < modeCount; ++k)
+		{
+			displacement += rows[axis * modeCount + k] * state.coordinates[k];
+			speed += rows[axis * modeCount + k] * state.velocities[k];
+		}
+		position[axis] = restPositions[particle][axis] + (float)displacement;
+		velocity[axis] = (float)speed;
+	}
+}
+
+void SubspaceModel::step(State& state, float timeStep, float time, const WindFunction& wind) const
+{
+	const size_t n = modeCount;
+	const double h = timeStep;
+	std::vector<glm::vec3> positions(supportParticles.size()), velocities(supportParticles.size());
+	for (size_t i = 0; i < supportParticles.size(); ++i)
+		reconstructParticle(state, supportParticles[i], positions[i], velocities[i]);
+
+	// (m I + h C + h^2 K) dv = h (f - h K v), with the spring stiffness K and the air resistance damping C reduced
+	// by the cubature
+	std::vector<double> system(n * n, 0.0), force = reducedGravity, stiffnessVelocity(n, 0.0), difference(3 * n), along(n);
+	for (size_t k = 0; k < n; ++k)
+		system[k * n + k] = mass;
+
+	for (const CubatureSpring& element : cubatureSprings)
+	{
+		const glm::vec3 delta = positions[element.support2] - positions[element.support1];
+		const float length = glm::length(delta);
+		if (length == 0.f) continue;
+
+		// Reduced spring direction D = U2 - U1, and the spring Hessian with its transverse term clamped
+		const Spring& spring = element.spring;
+		const glm::vec3 direction = delta / length;
+		const double transverse = std::max(0.0, 1.0 - (double)spring.restLength / length);
+		const double tension = (double)spring.stiffness * (length - spring.restLength);
+		const double* rows1 = getBasis(spring.particle1);
+		const double* rows2 = getBasis(spring.particle2);
+		double relativeVelocity[3] = { 0.0, 0.0, 0.0 };
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			for (size_t k = 0; k < n; ++k)
+			{
+				difference[axis * n + k] = rows2[axis * n + k] - rows1[axis * n + k];
+				relativeVelocity[axis] += difference[axis * n + k] * state.velocities[k];
+			}
+		}
+		const double velocityAlong = direction.x * relativeVelocity[0] + direction.y * relativeVelocity[1] + direction.z * relativeVelocity[2];
+		double hessianVelocity[3];
+		for (int axis = 0; axis < 3; ++axis)
+			hessianVelocity[axis] = spring.stiffness * ((1.0 - transverse) * direction[axis] * velocityAlong + transverse * relativeVelocity[axis]);
+
+		for (size_t j = 0; j < n; ++j)
+		{
+			along[j] = difference[j] * direction.x + difference[n + j] * direction.y + difference[2 * n + j] * direction.z;
+			force[j] -= element.weight * tension * along[j];
+			stiffnessVelocity[j] += element.weight * (difference[j] * hessianVelocity[0] + difference[n + j] * hessianVelocity[1] + difference[2 * n + j] * hessianVelocity[2]);
+		}
+		const double scale = h * h * element.weight * spring.stiffness;
+		for (size_t j = 0; j < n; ++j)
+		{
+			for (size_t k = j; k < n; ++k)
+			{
+				const double overlap = difference[j] * difference[k] + difference[n + j] * difference[n + k] + difference[2 * n + j] * difference[2 * n + k];
+				system[j * n + k] += scale * ((1.0 - transverse) * along[j] * along[k] + transverse * overlap);
+			}
+		}
+	}
+
+	for (const CubatureParticle& element : cubatureParticles)
+	{
+		const glm::vec3 velocity = velocities[element.support];
+		glm::vec3 particleForce = -airResistance * velocity * glm::abs(velocity);
+		if (wind)
+			particleForce += wind(positions[element.support], time);
+		const glm::vec3 damping = 2.f * airResistance * glm::abs(velocity);
+		const double* rows = getBasis(element.particle);
+		for (size_t j = 0; j < n; ++j)
+		{
+			force[j] += element.weight * (rows[j] * particleForce.x + rows[n + j] * particleForce.y + rows[2 * n + j] * particleForce.z);
+			for (size_t k = j; k < n; ++k)
+			{
+				const double entry = rows[j] * damping.x * rows[k] + rows[n + j] * damping.y * rows[n + k] + rows[2 * n + j] * damping.z * rows[2 * n + k];
+				system[j * n + k] += h * element.weight * entry;
+			}
+		}
+	}
+
+	for (size_t j = 0; j < n; ++j)
+	{
+		for (size_t k = 0; k < j; ++k)
+			system[j * n + k] = system[k * n + j];
+	}
+
+	std::vector<double> velocityChange(n);
+	for (size_t k = 0; k < n; ++k)
+		velocityChange[k] = h * (force[k] - h * stiffnessVelocity[k]);
+	if (!solveCholesky(system.data(), n, velocityChange.data()))
+		return;
+
+	for (size_t k = 0; k < n; ++k)
+	{
+		state.velocities[k] += velocityChange[k];
+		state.coordinates[k] += h * state.velocities[k];
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <glm/vec3.hpp>
+#include <vector>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+// Reduced-order cloth: particle displacements are mean + basis * q for a few dozen modes, found by PCA of the
+// snapshots of a full simulation. Spring, wind and air forces are integrated with cubature, a weighted subset of
+// springs and particles trained to reproduce the reduced forces of the snapshots, so a step costs the same for any
+// particle count and only the reconstruction for rendering touches every particle. Gravity is reduced exactly.
+// There is no collision response; the model is meant for background cloth such as flags and curtains.
+//
+// Particles are in their original row-major order and positions in the world space of the training cloth, so
+// cloths sharing a model have to share its transform.
+class SubspaceModel {
+public:
+	struct Spring {
+		uint32_t particle1;
+		uint32_t particle2;
+		float stiffness;
+		float restLength;
+	};
+
+	// Displacements from the rest positions and velocities of every particle at one training frame
+	struct Snapshot {
+		std::vector<glm::vec3> displacements;
+		std::vector<glm::vec3> velocities;
+		float time = 0.f;
+	};
+
+	// Wind force on a particle at a position and time
+	using WindFunction = std::function<glm::vec3(const glm::vec3&, float)>;
+
+	struct Description {
+		std::vector<glm::vec3> restPositions;
+		std::vector<float> inverseMass;
+		std::vector<Spring> springs;
+		float mass = 1.f;
+		glm::vec3 gravity{ 0.f, -9.81f, 0.f };
+		float airResistance = 0.f;
+		WindFunction wind;
+	};
+
+	// Reduced coordinates and their velocities
+	struct State {
+		std::vector<double> coordinates;
+		std::vector<double> velocities;
+	};
+
+	void build(const Description& cloth, const std::vector<Snapshot>& snapshots, size_t modeCount, size_t cubatureSize);
+	bool isBuilt() const { return modeCount > 0; }
+
+	// Best approximation of the given displacements and velocities in the subspace
+	void project(const std::vector<glm::vec3>& displacements, const std::vector<glm::vec3>& velocities, State& state) const;
+	void reconstruct(const State& state, std::vector<glm::vec3>& displacements, std::vector<glm::vec3>* velocities = nullptr) const;
+
+	// Linearized backward Euler step in reduced coordinates; wind is evaluated at the cubature particles only
+	void step(State& state, float timeStep, float time, const WindFunction& wind) const;
+
+	size_t getModeCount() const { return modeCount; }
+	size_t getParticleCount() const { return restPositions.size(); }
+	size_t getCubatureSize() const { return cubatureSprings.size() + cubatureParticles.size(); }
+
+	// Relative error of the cubature on the reduced training forces
+	double getCubatureError() const { return cubatureError; }
+
+	static constexpr size_t maxBasisSnapshots = 200;
+	static constexpr size_t maxCubaturePoses = 50;
+	static constexpr size_t cubatureCandidates = 512;
+
+private:
+	struct CubatureSpring {
+		Spring spring;
+		uint32_t support1;
+		uint32_t support2;
+		double weight;
+	};
+
+	struct CubatureParticle {
+		uint32_t particle;
+		uint32_t support;
+		double weight;
+	};
+
+	const double* getBasis(size_t particle) const { return basis.data() + particle * 3 * modeCount; }
+	void fitCubature(const Description& cloth, const std::vector<Snapshot>& snapshots, size_t cubatureSize);
+	void reconstructParticle(const State& state, uint32_t particle, glm::vec3& position, glm::vec3& velocity) const;
+
+	size_t modeCount = 0;
+	std::vector<glm::vec3> restPositions;
+	std::vector<double> mean;
+
+	// 3 rows of modeCount values per particle, orthonormal columns
+	std::vector<double> basis;
+	std::vector<double> reducedGravity;
+	float mass = 1.f;
+	float airResistance = 0.f;
+
+	// Cubature elements and the particles they read, which are the only ones reconstructed during a step
+	std::vector<CubatureSpring> cubatureSprings;
+	std::vector<CubatureParticle> cubatureParticles;
+	std::vector<uint32_t> supportParticles;
+	double cubatureError = 0.0;
+};
@@ -0,0 +1,134 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threadCount)
+{
+	threadCount = std::max(threadCount, 1u);
+	workers.reserve(threadCount - 1);
+	for (unsigned i = 1; i < threadCount; ++i)
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	workAvailable.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t minChunkSize, const std::function<void(size_t, size_t)>& body)
+{
+	if (begin >= end) return;
+	const size_t count = end - begin;
+	const size_t targetChunkCount = (size_t)getThreadCount() * 4;
+	const size_t size = std::max(std::max(minChunkSize, (size_t)1), (count + targetChunkCount - 1) / targetChunkCount);
+	if (workers.empty() || size >= count)
+	{
+		body(begin, end);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &body;
+		jobBegin = begin;
+		jobEnd = end;
+		chunkSize = size;
+		nextChunk = 0;
+		pendingWorkers = workers.size();
+		++generation;
+	}
+
+	workAvailable.notify_all();
+	runChunks();
+
+	// Every worker has to check in before the next job may be published
+	std::unique_lock<std::mutex> lock(mutex);
+	workDone.wait(lock, [this]() { return pendingWorkers == 0; });
+	job = nullptr;
+}
+
+void ThreadPool::workerLoop()
+{
+	uint64_t seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workAvailable.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+			if (stopping) return;
+			seenGeneration = generation;
+		}
+
+		runChunks();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--pendingWorkers == 0)
+			workDone.notify_one();
+	}
+}
+
+void ThreadPool::runChunks()
+{
+	while (true)
+	{
+		const size_t chunkBegin = jobBegin + nextChunk.fetch_add(1) * chunkSize;
+		if (chunkBegin >= jobEnd) return;
+		(*job)(chunkBegin, std::min(chunkBegin + chunkSize, jobEnd));
+	}
+}
+
+void parallelFor(ThreadPool* pool, size_t count, const std::function<void(size_t, size_t)>& body)
+{
+	if (pool)
+		pool->parallelFor(0, count, 1024, body);
+	else
+		body(0, count);
+}
+
+double parallelSum(ThreadPool* pool, size_t count, const std::function<double(size_t, size_t)>& body)
+{
+	constexpr size_t blockSize = 4096;
+	const size_t blockCount = (count + blockSize - 1) / blockSize;
+	std::vector<double> partialSums(blockCount);
+	auto sumBlocks = [&](size_t begin, size_t end) {
+		for (size_t b = begin; b < end; ++b)
+			partialSums[b] = body(b * blockSize, std::min((b + 1) * blockSize, count));
+	};
+
+	if (pool)
+		pool->parallelFor(0, blockCount, 1, sumBlocks);
+	else
+		sumBlocks(0, blockCount);
+
+	double sum = 0.0;
+	for (double partialSum : partialSums)
+		sum += partialSum;
+	return sum;
+}
+
+double parallelMax(ThreadPool* pool, size_t count, const std::function<double(size_t, size_t)>& body)
+{
+	constexpr size_t blockSize = 4096;
+	const size_t blockCount = (count + blockSize - 1) / blockSize;
+	std::vector<double> partialMaxima(blockCount);
+	auto maximizeBlocks = [&](size_t begin, size_t end) {
+		for (size_t b = begin; b < end; ++b)
+			partialMaxima[b] = body(b * blockSize, std::min((b + 1) * blockSize, count));
+	};
+
+	if (pool)
+		pool->parallelFor(0, blockCount, 1, maximizeBlocks);
+	else
+		maximizeBlocks(0, blockCount);
+
+	double maximum = 0.0;
+	for (double partialMaximum : partialMaxima)
+		maximum = std::max(maximum, partialMaximum);
+	return maximum;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+	explicit ThreadPool(unsigned threadCount = std::thread::hardware_concurrency());
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Number of threads taking part in parallelFor, including the calling thread
+	unsigned getThreadCount() const { return (unsigned)workers.size() + 1; }
+
+	// Splits [begin, end) into chunks of at least minChunkSize elements and runs body(chunkBegin, chunkEnd)
+	// for each of them on the workers and the calling thread. Returns once every chunk has finished.
+	void parallelFor(size_t begin, size_t end, size_t minChunkSize, const std::function<void(size_t, size_t)>& body);
+
+private:
+	void workerLoop();
+	void runChunks();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable workDone;
+	const std::function<void(size_t, size_t)>* job = nullptr;
+	size_t jobBegin = 0;
+	size_t jobEnd = 0;
+	size_t chunkSize = 0;
+	std::atomic<size_t> nextChunk{ 0 };
+	size_t pendingWorkers = 0;
+	uint64_t generation = 0;
+	bool stopping = false;
+};
+
+// Runs body over [0, count) on the pool, or inline when there is no pool
+void parallelFor(ThreadPool* pool, size_t count, const std::function<void(size_t, size_t)>& body);
+
+// Sums body(begin, end) over fixed-size blocks of [0, count). The block layout does not depend on the
+// thread count, so the result is the same for any pool.
+double parallelSum(ThreadPool* pool, size_t count, const std::function<double(size_t, size_t)>& body);
+
+// Largest body(begin, end) over the same fixed-size blocks, or 0 for an empty range
+double parallelMax(ThreadPool* pool, size_t count, const std::function<double(size_t, size_t)>& body);
@@ -0,0 +1,8 @@
+#pragma once
+
+struct Time {
+	float deltaTime = 0.f;
+	float lastDeltaTime = 0.f;
+	float runningTime = 0.f;
+	float frameRate = 0.f;
+};
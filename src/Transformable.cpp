@@ -0,0 +1,35 @@
+#include "Transformable.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+Transformable::Transformable() : rotationQuat(glm::angleAxis(0.f, glm::vec3(1.f, 0.f, 0.f)))
+{
+}
+
+void Transformable::rotate(float angle, const glm::vec3& axis)
+{
+	rotationQuat = glm::angleAxis(glm::radians(angle), axis);
+	updateTransformMatrix();
+}
+
+void Transformable::scale(const glm::vec3& scale)
+{
+	scaleVector = scale;
+	updateTransformMatrix();
+}
+
+void Transformable::translate(const glm::vec3& translation)
+{
+	translationVector = translation;
+	updateTransformMatrix();
+}
+
+void Transformable::updateTransformMatrix()
+{
+	const glm::mat4 newTransformMatrix = glm::scale(glm::translate(glm::mat4(1.f), translationVector) * glm::mat4_cast(rotationQuat), scaleVector);
+	if (newTransformMatrix != transformMatrix)
+	{
+		transformMatrix = newTransformMatrix;
+		++transformVersion;
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/ext/quaternion_float.hpp>
+#include <cstdint>
+
+class Transformable {
+public:
+	Transformable();
+	virtual ~Transformable() = default;
+	void rotate(float angle, const glm::vec3& axis);
+	void scale(const glm::vec3& factor);
+	void translate(const glm::vec3& factor);
+	const glm::mat4& getTransformMatrix() const { return transformMatrix; }
+	const glm::vec3& getScale() const { return scaleVector; }
+	const glm::vec3& getTranslation() const { return translationVector; }
+
+	// Incremented whenever the transform matrix actually changes, so dependent data can be cached
+	uint64_t getTransformVersion() const { return transformVersion; }
+
+protected:
+	void updateTransformMatrix();
+	uint64_t transformVersion = 0;
+	glm::mat4 transformMatrix{ 1.f };
+	glm::quat rotationQuat;
+	glm::vec3 translationVector{ 0.f };
+	glm::vec3 scaleVector{ 1.f };
+};
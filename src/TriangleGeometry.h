@@ -0,0 +1,58 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// Features of a triangle abc a point can be closest to: the vertices, the edges ab, bc, ca and the face
+enum TriangleFeature { VertexA, VertexB, VertexC, EdgeAB, EdgeBC, EdgeCA, Face, TriangleFeatureCount };
+
+// Closest point on triangle abc, after Ericson's Real-Time Collision Detection, 5.1.5
+inline glm::vec3 closestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, TriangleFeature& feature)
+{
+	const glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+	const float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+	if (d1 <= 0.f && d2 <= 0.f)
+	{
+		feature = VertexA;
+		return a;
+	}
+
+	const glm::vec3 bp = p - b;
+	const float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+	if (d3 >= 0.f && d4 <= d3)
+	{
+		feature = VertexB;
+		return b;
+	}
+
+	const float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+	{
+		feature = EdgeAB;
+		return a + ab * (d1 / (d1 - d3));
+	}
+
+	const glm::vec3 cp = p - c;
+	const float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+	if (d6 >= 0.f && d5 <= d6)
+	{
+		feature = VertexC;
+		return c;
+	}
+
+	const float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+	{
+		feature = EdgeCA;
+		return a + ac * (d2 / (d2 - d6));
+	}
+
+	const float va = d3 * d6 - d5 * d4;
+	if (va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f)
+	{
+		feature = EdgeBC;
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	}
+
+	const float denominator = 1.f / (va + vb + vc);
+	feature = Face;
+	return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
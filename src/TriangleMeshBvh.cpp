@@ -0,0 +1,213 @@
+#include "TriangleMeshBvh.h"
+#include "TriangleGeometry.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <unordered_map>
+#include <limits>
+#include <cmath>
+
+void TriangleMeshBvh::build(const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& _indices)
+{
+	vertexCount = vertices.size();
+	nodes.clear();
+	indices.clear();
+	neighbours.clear();
+	cornerAngles.clear();
+	const uint32_t triangleCount = (uint32_t)(_indices.size() / 3);
+	if (triangleCount == 0)
+		return;
+
+	std::vector<uint32_t> triangles(triangleCount);
+	std::vector<glm::vec3> centroids(triangleCount);
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		triangles[t] = t;
+		centroids[t] = (vertices[_indices[3 * t]] + vertices[_indices[3 * t + 1]] + vertices[_indices[3 * t + 2]]) / 3.f;
+	}
+	nodes.reserve(2 * (triangleCount / leafSize + 1));
+	buildNode(triangles, centroids, 0, triangleCount);
+
+	// Triangles in leaf order, so that a leaf reads its corners contiguously
+	indices.resize(3 * (size_t)triangleCount);
+	cornerAngles.resize(indices.size());
+	for (uint32_t t = 0; t < triangleCount; ++t)
+		std::copy(_indices.begin() + 3 * (size_t)triangles[t], _indices.begin() + 3 * (size_t)triangles[t] + 3, indices.begin() + 3 * (size_t)t);
+
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			const glm::vec3 toNext = vertices[indices[3 * t + (k + 1) % 3]] - vertices[indices[3 * t + k]];
+			const glm::vec3 toPrevious = vertices[indices[3 * t + (k + 2) % 3]] - vertices[indices[3 * t + k]];
+			const float lengths = glm::length(toNext) * glm::length(toPrevious);
+			cornerAngles[3 * t + k] = lengths > 0.f ? std::acos(glm::clamp(glm::dot(toNext, toPrevious) / lengths, -1.f, 1.f)) : 0.f;
+		}
+	}
+
+	// With consistent winding the triangle across an edge has it the other way around
+	std::unordered_map<uint64_t, uint32_t> edges;
+	edges.reserve(indices.size());
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		for (int k = 0; k < 3; ++k)
+			edges[(uint64_t)indices[3 * t + k] << 32 | indices[3 * t + (k + 1) % 3]] = t;
+	}
+	neighbours.assign(indices.size(), noTriangle);
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			auto found = edges.find((uint64_t)indices[3 * t + (k + 1) % 3] << 32 | indices[3 * t + k]);
+			if (found != edges.end())
+				neighbours[3 * t + k] = found->second;
+		}
+	}
+}
+
+uint32_t TriangleMeshBvh::buildNode(std::vector<uint32_t>& triangles, const std::vector<glm::vec3>& centroids, uint32_t begin, uint32_t end)
+{
+	const uint32_t node = (uint32_t)nodes.size();
+	nodes.push_back({ begin, end - begin });
+	if (end - begin <= leafSize)
+		return node;
+
+	// Median split along the longest axis of the centroids, which keeps the tree balanced
+	glm::vec3 lower(std::numeric_limits<float>::max()), upper(-std::numeric_limits<float>::max());
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		lower = glm::min(lower, centroids[triangles[i]]);
+		upper = glm::max(upper, centroids[triangles[i]]);
+	}
+	const glm::vec3 extent = upper - lower;
+	const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+	const uint32_t middle = begin + (end - begin) / 2;
+	std::nth_element(triangles.begin() + begin, triangles.begin() + middle, triangles.begin() + end,
+		[&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+	buildNode(triangles, centroids, begin, middle);
+	const uint32_t second = buildNode(triangles, centroids, middle, end);
+	nodes[node] = { second, 0 };
+	return node;
+}
+
+void TriangleMeshBvh::refit(const std::vector<glm::vec3>& vertices, Pose& pose) const
+{
+	pose.vertices = vertices;
+	const size_t triangleCount = getTriangleCount();
+	pose.faceNormals.resize(triangleCount);
+	pose.vertexNormals.assign(vertices.size(), glm::vec3(0.f));
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		const uint32_t* corner = &indices[3 * t];
+		const glm::vec3 normal = glm::cross(vertices[corner[1]] - vertices[corner[0]], vertices[corner[2]] - vertices[corner[0]]);
+		const float area = glm::length(normal);
+		pose.faceNormals[t] = area > 0.f ? normal / area : glm::vec3(0.f);
+		for (int k = 0; k < 3; ++k)
+			pose.vertexNormals[corner[k]] += cornerAngles[3 * t + k] * pose.faceNormals[t];
+	}
+
+	// Children are stored after their parent, so a single pass from the back sees every child before its parent
+	pose.boundsMin.resize(nodes.size());
+	pose.boundsMax.resize(nodes.size());
+	for (size_t n = nodes.size(); n-- > 0;)
+	{
+		const Node& node = nodes[n];
+		if (node.count == 0)
+		{
+			pose.boundsMin[n] = glm::min(pose.boundsMin[n + 1], pose.boundsMin[node.first]);
+			pose.boundsMax[n] = glm::max(pose.boundsMax[n + 1], pose.boundsMax[node.first]);
+			continue;
+		}
+
+		glm::vec3 lower(std::numeric_limits<float>::max()), upper(-std::numeric_limits<float>::max());
+		for (size_t i = 3 * (size_t)node.first; i < 3 * ((size_t)node.first + node.count); ++i)
+		{
+			lower = glm::min(lower, vertices[indices[i]]);
+			upper = glm::max(upper, vertices[indices[i]]);
+		}
+		pose.boundsMin[n] = lower;
+		pose.boundsMax[n] = upper;
+	}
+}
+
+bool TriangleMeshBvh::closestPoint(const Pose& pose, const glm::vec3& point, float maxDistance, float& distance, glm::vec3& direction) const
+{
+	if (nodes.empty())
+		return false;
+
+	auto boxDistanceSquared = [&](uint32_t node) {
+		const glm::vec3 outside = glm::max(glm::max(pose.boundsMin[node] - point, point - pose.boundsMax[node]), glm::vec3(0.f));
+		return glm::dot(outside, outside);
+	};
+
+	float bestSquared = maxDistance * maxDistance;
+	uint32_t bestTriangle = noTriangle;
+	TriangleFeature bestFeature = Face;
+	glm::vec3 bestPoint(0.f);
+
+	// The tree is balanced, so its depth stays far below the stack size
+	uint32_t stack[64];
+	size_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const uint32_t n = stack[--stackSize];
+		if (boxDistanceSquared(n) >= bestSquared)
+			continue;
+
+		const Node& node = nodes[n];
+		if (node.count > 0)
+		{
+			for (uint32_t t = node.first; t < node.first + node.count; ++t)
+			{
+				TriangleFeature feature;
+				const glm::vec3 closest = closestPointOnTriangle(point, pose.vertices[indices[3 * t]], pose.vertices[indices[3 * t + 1]],
+					pose.vertices[indices[3 * t + 2]], feature);
+				const float distanceSquared = glm::dot(point - closest, point - closest);
+				if (distanceSquared < bestSquared)
+				{
+					bestSquared = distanceSquared;
+					bestTriangle = t;
+					bestFeature = feature;
+					bestPoint = closest;
+				}
+			}
+			continue;
+		}
+
+		// The nearer child goes on top, so that it shrinks the search radius before the other one is tested
+		uint32_t nearer = n + 1, farther = node.first;
+		if (boxDistanceSquared(farther) < boxDistanceSquared(nearer))
+			std::swap(nearer, farther);
+		stack[stackSize++] = farther;
+		stack[stackSize++] = nearer;
+	}
+
+	if (bestTriangle == noTriangle)
+		return false;
+
+	// The side comes from the angle-weighted pseudonormal of the closest feature, which is right even where the
+	// closest point lies on an edge or vertex
+	glm::vec3 normal = pose.faceNormals[bestTriangle];
+	if (bestFeature <= VertexC)
+		normal = pose.vertexNormals[indices[3 * bestTriangle + bestFeature - VertexA]];
+	else if (bestFeature <= EdgeCA)
+	{
+		const uint32_t neighbour = neighbours[3 * bestTriangle + bestFeature - EdgeAB];
+		if (neighbour != noTriangle)
+			normal += pose.faceNormals[neighbour];
+	}
+
+	const glm::vec3 offset = point - bestPoint;
+	const float length = std::sqrt(bestSquared);
+	const bool behind = glm::dot(offset, normal) < 0.f;
+	distance = behind ? -length : length;
+	if (length > 1e-6f)
+		direction = offset * ((behind ? -1.f : 1.f) / length);
+	else
+	{
+		const float normalLength = glm::length(normal);
+		direction = normalLength > 0.f ? normal / normalLength : pose.faceNormals[bestTriangle];
+	}
+	return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <glm/vec3.hpp>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Bounding volume hierarchy over the triangles of a mesh that deforms but keeps its connectivity, such as a skinned
+// character. The tree is built once, from the rest pose; every later pose only refits the node bounds bottom-up, which
+// keeps the tree valid, if looser the further the pose moves from the rest pose. Poses are kept apart from the tree so
+// that one tree serves every copy of the mesh and every collision world it is in.
+class TriangleMeshBvh {
+public:
+	// Vertices of the mesh in one pose, with the normals and node bounds the closest point queries need
+	struct Pose {
+		std::vector<glm::vec3> vertices;
+		std::vector<glm::vec3> vertexNormals;
+		std::vector<glm::vec3> faceNormals;
+		std::vector<glm::vec3> boundsMin;
+		std::vector<glm::vec3> boundsMax;
+	};
+
+	void build(const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& indices);
+	void refit(const std::vector<glm::vec3>& vertices, Pose& pose) const;
+
+	// Signed distance from the point to the closest triangle within maxDistance, negative behind the surface, and the
+	// unit direction from the surface towards its front. False if no triangle is that close.
+	bool closestPoint(const Pose& pose, const glm::vec3& point, float maxDistance, float& distance, glm::vec3& direction) const;
+
+	bool isBuilt() const { return !nodes.empty(); }
+	size_t getVertexCount() const { return vertexCount; }
+	size_t getTriangleCount() const { return indices.size() / 3; }
+	size_t getNodeCount() const { return nodes.size(); }
+
+	static constexpr uint32_t leafSize = 4;
+
+private:
+	// Nodes are stored depth first. Leaves hold count triangles from first on; inner nodes have a count of zero, their
+	// first child right after them and their second child at first.
+	struct Node {
+		uint32_t first;
+		uint32_t count;
+	};
+
+	uint32_t buildNode(std::vector<uint32_t>& triangles, const std::vector<glm::vec3>& centroids, uint32_t begin, uint32_t end);
+
+	static constexpr uint32_t noTriangle = UINT32_MAX;
+	size_t vertexCount = 0;
+	std::vector<Node> nodes;
+
+	// Corners of the triangles in leaf order and, for the edges ab, bc and ca of each, the triangle across the edge
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> neighbours;
+
+	// Angles at the corners of the rest pose, which weight the vertex normals of every pose. Deformations such as
+	// skinning barely change them, and they would cost an arccosine per corner and pose otherwise.
+	std::vector<float> cornerAngles;
+};
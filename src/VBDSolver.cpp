@@ -0,0 +1,77 @@
+#include "VBDSolver.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+
+void VBDSolver::initialize(const Particles& particles, const Coloring& vertexColoring, const std::vector<uint32_t>& _adjacencyOffsets, const std::vector<uint32_t>& _adjacency)
+{
+	coloring = vertexColoring;
+	adjacencyOffsets = &_adjacencyOffsets;
+	adjacency = &_adjacency;
+	inertialX.resize(particles.size());
+	inertialY.resize(particles.size());
+	inertialZ.resize(particles.size());
+}
+
+void VBDSolver::solve(Particles& particles, const Springs& springs, float mass, float timeStep, ThreadPool* pool)
+{
+	solve(particles, springs, mass, timeStep, pool, nullptr, nullptr, nullptr);
+}
+
+void VBDSolver::solve(Particles& particles, const Springs& springs, float mass, float timeStep, ThreadPool* pool, const float* startX, const float* startY, const float* startZ)
+{
+	std::copy(particles.x.begin(), particles.x.end(), inertialX.begin());
+	std::copy(particles.y.begin(), particles.y.end(), inertialY.begin());
+	std::copy(particles.z.begin(), particles.z.end(), inertialZ.begin());
+	if (startX)
+	{
+		std::copy(startX, startX + particles.size(), particles.x.begin());
+		std::copy(startY, startY + particles.size(), particles.y.begin());
+		std::copy(startZ, startZ + particles.size(), particles.z.begin());
+	}
+
+	const float inertia = mass / (timeStep * timeStep);
+	const std::vector<uint32_t>& offsets = *adjacencyOffsets;
+	const std::vector<uint32_t>& entries = *adjacency;
+	for (unsigned iteration = 0; iteration < iterations; ++iteration)
+	{
+		for (size_t c = 0; c < coloring.getColorCount(); ++c)
+		{
+			const uint32_t colorBegin = coloring.colorOffsets[c];
+			parallelFor(pool, coloring.colorOffsets[c + 1] - colorBegin, [&](size_t begin, size_t end) {
+				for (size_t k = colorBegin + begin; k < colorBegin + end; ++k)
+				{
+					const uint32_t i = coloring.order[k];
+					if (particles.inverseMass[i] == 0.f) continue;
+
+					const glm::vec3 position = particles.getPosition(i);
+					glm::vec3 force = inertia * (glm::vec3(inertialX[i], inertialY[i], inertialZ[i]) - position);
+					glm::mat3 hessian(inertia);
+					for (uint32_t a = offsets[i]; a < offsets[i + 1]; ++a)
+					{
+						const uint32_t s = entries[a] >> 1;
+						const uint32_t neighbour = (entries[a] & 1) ? springs.particle1[s] : springs.particle2[s];
+						const glm::vec3 delta = particles.getPosition(neighbour) - position;
+						const float length = glm::length(delta);
+						if (length == 0.f) continue;
+
+						// Spring Hessian with the transverse term clamped, so compressed springs keep it definite
+						const glm::vec3 direction = delta / length;
+						const glm::mat3 longitudinal = glm::outerProduct(direction, direction);
+						const float transverse = std::max(0.f, 1.f - springs.restLength[s] / length);
+						const float stiffness = springs.stiffness[s];
+						force += stiffness * (length - springs.restLength[s]) * direction;
+						hessian += stiffness * (longitudinal + transverse * (glm::mat3(1.f) - longitudinal));
+					}
+
+					const float determinant = glm::determinant(hessian);
+					if (determinant <= 1e-12f) continue;
+
+					const glm::vec3 step = glm::inverse(hessian) * force;
+					particles.x[i] += step.x;
+					particles.y[i] += step.y;
+					particles.z[i] += step.z;
+				}
+			});
+		}
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "Particles.h"
+#include "Springs.h"
+#include "GraphColoring.h"
+#include "ThreadPool.h"
+#include <vector>
+
+// Vertex block descent: every particle minimizes the incremental potential
+//     m / (2 h^2) |x - y|^2 + sum of its incident spring energies
+// with a single 3x3 Newton step while its neighbours are held fixed. Vertices of one color share no
+// spring, so each color is updated in parallel and colors are swept Gauss-Seidel style.
+class VBDSolver {
+public:
+	void initialize(const Particles& particles, const Coloring& vertexColoring, const std::vector<uint32_t>& adjacencyOffsets, const std::vector<uint32_t>& adjacency);
+	bool isInitialized() const { return coloring.getColorCount() > 0; }
+
+	// Particle positions have to hold the inertial prediction y, they are replaced by the solution
+	void solve(Particles& particles, const Springs& springs, float mass, float timeStep, ThreadPool* pool);
+
+	// Same, but the descent starts from the given positions instead of from the prediction
+	void solve(Particles& particles, const Springs& springs, float mass, float timeStep, ThreadPool* pool, const float* startX, const float* startY, const float* startZ);
+
+	void setIterations(unsigned count) { iterations = count; }
+	unsigned getIterations() const { return iterations; }
+
+private:
+	Coloring coloring;
+	const std::vector<uint32_t>* adjacencyOffsets = nullptr;
+	const std::vector<uint32_t>* adjacency = nullptr;
+	std::vector<float> inertialX, inertialY, inertialZ;
+	unsigned iterations = 10;
+};
@@ -4,13 +4,7 @@
 #include <glm/vec3.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec4.hpp>
-
-struct Time {
-	float deltaTime = 0.f;
-	float lastDeltaTime = 0.f;
-	float runningTime = 0.f;
-	float frameRate = 0.f;
-};
+#include "Time.h"
 
 class Window {
 public:
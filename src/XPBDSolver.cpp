@@ -0,0 +1,59 @@
+#include "XPBDSolver.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+
+void XPBDSolver::initialize(const Springs& springs, const std::vector<uint32_t>& adjacencyOffsets, const std::vector<uint32_t>& adjacency)
+{
+	coloring = colorSprings(springs, adjacencyOffsets, adjacency);
+	lambdas.assign(springs.size(), 0.f);
+	complianceTimeStep = 0.f;
+}
+
+void XPBDSolver::solve(Particles& particles, const Springs& springs, float timeStep, ThreadPool* pool)
+{
+	std::fill(lambdas.begin(), lambdas.end(), 0.f);
+	if (timeStep != complianceTimeStep)
+	{
+		const float inverseTimeStepSquared = 1.f / (timeStep * timeStep);
+		compliances.resize(coloring.order.size());
+		for (size_t k = 0; k < coloring.order.size(); ++k)
+			compliances[k] = inverseTimeStepSquared / springs.stiffness[coloring.order[k]];
+		complianceTimeStep = timeStep;
+	}
+
+	for (unsigned iteration = 0; iteration < iterations; ++iteration)
+	{
+		for (size_t c = 0; c < coloring.getColorCount(); ++c)
+		{
+			const uint32_t colorBegin = coloring.colorOffsets[c];
+			parallelFor(pool, coloring.colorOffsets[c + 1] - colorBegin, [&](size_t begin, size_t end) {
+				for (size_t k = colorBegin + begin; k < colorBegin + end; ++k)
+				{
+					const uint32_t s = coloring.order[k];
+					const uint32_t p1 = springs.particle1[s];
+					const uint32_t p2 = springs.particle2[s];
+					const float w1 = particles.inverseMass[p1];
+					const float w2 = particles.inverseMass[p2];
+					if (w1 + w2 == 0.f) continue;
+
+					const glm::vec3 delta = particles.getPosition(p2) - particles.getPosition(p1);
+					const float length = glm::length(delta);
+					if (length == 0.f) continue;
+
+					const float compliance = compliances[k];
+					const float constraint = length - springs.restLength[s];
+					const float deltaLambda = (-constraint - compliance * lambdas[s]) / (w1 + w2 + compliance);
+					lambdas[s] += deltaLambda;
+
+					const glm::vec3 correction = (deltaLambda / length) * delta;
+					particles.x[p1] -= w1 * correction.x;
+					particles.y[p1] -= w1 * correction.y;
+					particles.z[p1] -= w1 * correction.z;
+					particles.x[p2] += w2 * correction.x;
+					particles.y[p2] += w2 * correction.y;
+					particles.z[p2] += w2 * correction.z;
+				}
+			});
+		}
+	}
+}
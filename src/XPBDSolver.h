@@ -0,0 +1,30 @@
+#pragma once
+#include "Particles.h"
+#include "Springs.h"
+#include "GraphColoring.h"
+#include "ThreadPool.h"
+#include <vector>
+
+// Extended position based dynamics: every spring is a distance constraint with compliance 1 / stiffness.
+// Constraints are projected with Gauss-Seidel sweeps over a spring coloring, one color at a time in parallel.
+class XPBDSolver {
+public:
+	void initialize(const Springs& springs, const std::vector<uint32_t>& adjacencyOffsets, const std::vector<uint32_t>& adjacency);
+	bool isInitialized() const { return coloring.getColorCount() > 0; }
+
+	// Projects the constraints on positions predicted for a (sub)step of the given length
+	void solve(Particles& particles, const Springs& springs, float timeStep, ThreadPool* pool);
+
+	void setIterations(unsigned count) { iterations = count; }
+	unsigned getIterations() const { return iterations; }
+
+private:
+	Coloring coloring;
+	std::vector<float> lambdas;
+
+	// Time-scaled compliance per spring, in coloring order, for the step length it was computed for
+	std::vector<float> compliances;
+	float complianceTimeStep = 0.f;
+
+	unsigned iterations = 1;
+};
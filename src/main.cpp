@@ -1,5 +1,7 @@
 #include "Sphere.h"
 #include "Cloth.h"
+#include "ClothMesh.h"
+#include "PhysicsThread.h"
 #include "Window.h"
 #include <memory>
 #include "Camera.h"
@@ -7,6 +9,7 @@
 #include "Cube.h"
 #include <glm/gtc/matrix_access.hpp>
 #include <iostream>
+#include <vector>
 
 int main()
 {
@@ -35,7 +38,13 @@ int main()
 	std::unique_ptr<Cloth> cloth(new Cloth(50, 30));
 	cloth->scale(glm::vec3(10.f, 10.f, 1.f));
 	cloth->rotate(-90.f, glm::vec3(1.f, 0.f, 0.f));
-	cloth->color = glm::vec3(1.0f, 1.f, 0.7f);
+	cloth->setThreadPool(std::make_shared<ThreadPool>());
+	cloth->setAdaptiveTimeStep(true);
+	cloth->setTethers(true);
+	cloth->setContinuousCollision(true);
+	cloth->setSelfCollision(true);
+	std::unique_ptr<ClothMesh> clothMesh(new ClothMesh(*cloth));
+	clothMesh->color = glm::vec3(1.0f, 1.f, 0.7f);
 	Texture clothTexture("fabric.jpg", GL_TEXTURE_2D, true);
 	
 	// Skybox
@@ -56,6 +65,15 @@ int main()
 	lightingShader.setFloat("light.quadratic", 0.0021f);
 
 	glm::vec3 sphereTranslation = sphere->getTranslation();
+	std::vector<glm::vec3> clothTranslations;
+	cloth->getTranslations(clothTranslations);
+
+	// Physics runs at its own fixed rate, the render loop only picks up finished steps
+	PhysicsThread physics(*cloth);
+	CollisionWorld colliders;
+	colliders.add(sphere->getCollider());
+	physics.setColliders(colliders);
+	physics.start();
 
 	glViewport(0, 0, window->getWindowSize().x, window->getWindowSize().y);
 	do {
@@ -89,11 +107,11 @@ int main()
 		lightingShader.setBool("cloth", true);
 		lightingShader.setBool("tex", true);
 		clothTexture.activateAndBind(GL_TEXTURE0);
-		cloth->updatePhysics(window->getTime(), *sphere);
+		physics.readTranslations(clothTranslations);
 		lightingShader.setMat4("model", cloth->getTransformMatrix());
-		lightingShader.setVec3Array("vertexTranslation", cloth->getTranslations().size(), cloth->getTranslations().data());
-		cloth->updateColorsBasedOnMaterial(lightingShader, Entity::Material::FABRIC);
-		cloth->draw();
+		lightingShader.setVec3Array("vertexTranslation", clothTranslations.size(), clothTranslations.data());
+		clothMesh->updateColorsBasedOnMaterial(lightingShader, Entity::Material::FABRIC);
+		clothMesh->draw();
 
 		// Input controls
 		const glm::vec3 forwardDirection = glm::cross(glm::vec3(0.f, 1.f, 0.f), cam.getUDirection());
@@ -104,6 +122,9 @@ int main()
 		if (window->isKeyPressed(GLFW_KEY_RIGHT_SHIFT)) sphereTranslation.y += window->getTime().deltaTime * 10.f;
 		if (window->isKeyPressed(GLFW_KEY_RIGHT_CONTROL)) sphereTranslation.y -= window->getTime().deltaTime * 10.f;
 		sphere->translate(sphereTranslation);
+		colliders.clear();
+		colliders.add(sphere->getCollider());
+		physics.setColliders(colliders);
 		
 		if (window->isKeyPressed(GLFW_KEY_W))
 			cam.moveCamera(Camera::Directions::FORWARD, window->getTime().deltaTime);